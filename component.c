@@ -43,9 +43,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "sink.h"
 #include "component.h"
 
-typedef void (*print_func_t)(component_t self, FILE *out);
+typedef void (*print_func_t)(component_t self, sink_t out);
 
 struct component
 {
@@ -61,6 +62,12 @@ struct component
     /* The nonterminal's index */
     int index;
 
+    /* The terminal's precedence level, or 0 if it has none */
+    int precedence;
+
+    /* The terminal's associativity */
+    associativity_t associativity;
+
     /* The nonterminal's name */
     char name[1];
 };
@@ -82,6 +89,8 @@ component_alloc(char *filename, int line, char *name, int index)
     self->filename = NULL;
     self->line = line;
     self->index = index;
+    self->precedence = 0;
+    self->associativity = ASSOC_NONASSOC;
 
     /* Copy the name into place */
     memcpy(self->name, name, length + 1);
@@ -114,30 +123,31 @@ component_get_origin(component_t self, char **filename_out)
 
 /* Pretty-prints the receiver */
 void
-component_print(component_t self, FILE *out)
+component_print(component_t self, sink_t out)
 {
     self->print(self, out);
 }
 
 /* Prints the receiver as a C enum entry */
 void
-component_print_c_enum(component_t self, FILE *out)
+component_print_c_enum(component_t self, sink_t out)
 {
     if (self->index == 0) {
-        fprintf(out, "    TT_EOF = 0");
+        sink_puts(out, "    TT_EOF = 0");
     } else {
-        fprintf(out, ",\n    TT_%s", self->name);
+        sink_puts(out, ",\n    TT_");
+        sink_puts(out, self->name);
     }
 }
 
 /* Prints the receiver as a python assignment statement */
 void
-component_print_python_assign(component_t self, FILE *out)
+component_print_python_assign(component_t self, sink_t out)
 {
     if (self->index == 0) {
-        fprintf(out, "TT_EOF = 0\n");
+        sink_puts(out, "TT_EOF = 0\n");
     } else {
-        fprintf(out, "TT_%s = %d\n", self->name, self->index);
+        sink_printf(out, "TT_%s = %d\n", self->name, self->index);
     }
 }
 
@@ -155,20 +165,48 @@ component_get_index(component_t self)
     return self->index;
 }
 
+/* Sets the receiver's index */
+void
+component_set_index(component_t self, int index)
+{
+    self->index = index;
+}
+
+/* Sets the receiver's precedence level and associativity */
+void
+component_set_precedence(component_t self, int level,
+                         associativity_t associativity)
+{
+    self->precedence = level;
+    self->associativity = associativity;
+}
+
+/* Returns the receiver's precedence level and associativity */
+int
+component_get_precedence(component_t self,
+                         associativity_t *associativity_out)
+{
+    *associativity_out = self->associativity;
+    return self->precedence;
+}
+
 
 
 /* Pretty-print function for a nonterminal */
 static void
-nonterminal_print(component_t self, FILE *out)
+nonterminal_print(component_t self, sink_t out)
 {
-    fprintf(out, "<%s> ", self->name);
+    sink_putc(out, '<');
+    sink_puts(out, self->name);
+    sink_puts(out, "> ");
 }
 
 /* Pretty-print function for a terminal */
 static void
-terminal_print(component_t self, FILE *out)
+terminal_print(component_t self, sink_t out)
 {
-    fprintf(out, "%s ", self->name);
+    sink_puts(out, self->name);
+    sink_putc(out, ' ');
 }
 
 
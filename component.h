@@ -42,6 +42,21 @@
 /* The component type */
 typedef struct component *component_t;
 
+/* The associativity of a terminal with a declared precedence */
+enum associativity
+{
+    /* a - b - c is (a - b) - c */
+    ASSOC_LEFT,
+
+    /* a = b = c is a = (b = c) */
+    ASSOC_RIGHT,
+
+    /* a < b < c is an error */
+    ASSOC_NONASSOC
+};
+
+typedef enum associativity associativity_t;
+
 
 /* Allocates and initializes a new nonterminal component_t */
 component_t nonterminal_alloc(char *filename, int line, char *name, int index);
@@ -56,13 +71,13 @@ void component_free(component_t self);
 int component_get_origin(component_t self, char **filename_out);
 
 /* Pretty-prints the receiver */
-void component_print(component_t self, FILE *out);
+void component_print(component_t self, sink_t out);
 
 /* Prints the receiver as a C enum entry */
-void component_print_c_enum(component_t self, FILE *out);
+void component_print_c_enum(component_t self, sink_t out);
 
 /* Prints the receiver as a python assignment */
-void component_print_python_assign(component_t self, FILE *out);
+void component_print_python_assign(component_t self, sink_t out);
 
 /* Returns the receiver's name */
 char *component_get_name(component_t self);
@@ -70,7 +85,20 @@ char *component_get_name(component_t self);
 /* Returns the receiver's index */
 int component_get_index(component_t self);
 
+/* Sets the receiver's index */
+void component_set_index(component_t self, int index);
+
 /* Returns nonzero if the component is a nonterminal */
 int component_is_nonterminal(component_t self);
 
+/* Sets the receiver's precedence level, where higher levels bind
+ * more tightly, and its associativity */
+void component_set_precedence(component_t self, int level,
+                              associativity_t associativity);
+
+/* Returns the receiver's precedence level, or 0 if none was declared,
+ * and stores its associativity in associativity_out */
+int component_get_precedence(component_t self,
+                             associativity_t *associativity_out);
+
 #endif /* COMPONENET_H */
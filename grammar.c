@@ -43,9 +43,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include "sink.h"
 #include "component.h"
 #include "production.h"
 #include "grammar.h"
+#include "tpc_runtime.h"
 
 /* The kernel data structure */
 typedef struct kernel *kernel_t;
@@ -65,6 +68,13 @@ struct kernel
 
     /* The kernel's follows tables */
     char **follows_table;
+
+    /* The kernel's shift/reduce actions, indexed by terminal */
+    int *actions;
+
+    /* The spontaneous follows sets of the empty productions in the
+     * kernel's closure, indexed by production */
+    char **empty_follows;
 };
 
 /* Allocates and initializes a new kernel_t */
@@ -84,6 +94,8 @@ kernel_alloc(int count, int *pairs, int terminal_count)
     self->pairs = pairs;
     self->goto_table = NULL;
     self->follows_table = NULL;
+    self->actions = NULL;
+    self->empty_follows = NULL;
 
     /* Allocate some room for the propagates table */
     self->propagates_table = (char **)calloc(count, sizeof(char *));
@@ -114,11 +126,30 @@ kernel_alloc(int count, int *pairs, int terminal_count)
     return self;
 }
 
-#if 0
 /* Releases the resources consumed by the receiver */
 static void
-kernel_free(kernel_t self)
+kernel_free(kernel_t self, int production_count)
 {
+    int index;
+
+    for (index = 0; index < self->count; index++) {
+        if (self->propagates_table[index] != NULL) {
+            free(self->propagates_table[index]);
+        }
+
+        free(self->follows_table[index]);
+    }
+
+    if (self->empty_follows != NULL) {
+        for (index = 0; index < production_count; index++) {
+            if (self->empty_follows[index] != NULL) {
+                free(self->empty_follows[index]);
+            }
+        }
+
+        free(self->empty_follows);
+    }
+
     if (self->pairs != NULL) {
         free(self->pairs);
     }
@@ -127,9 +158,14 @@ kernel_free(kernel_t self)
         free(self->goto_table);
     }
 
+    if (self->actions != NULL) {
+        free(self->actions);
+    }
+
+    free(self->propagates_table);
+    free(self->follows_table);
     free(self);
 }
-#endif /* 0 */
 
 /* Returns nonzero if the kernel matches the set of encoded
  * (production, offset) pairs */
@@ -165,6 +201,59 @@ kernel_set_follows(kernel_t self, int code, int terminal_index)
     abort();
 }
 
+/* Adds the terminal to the follows set of an empty production in the
+ * kernel's closure */
+static void
+kernel_set_empty_follows(kernel_t self, int production_count,
+                         int production_index, int terminal_count,
+                         int terminal_index)
+{
+    /* Make the table and its entry if they don't already exist */
+    if (self->empty_follows == NULL) {
+        self->empty_follows =
+            (char **)calloc(production_count, sizeof(char *));
+        if (self->empty_follows == NULL) {
+            abort();
+        }
+    }
+
+    if (self->empty_follows[production_index] == NULL) {
+        self->empty_follows[production_index] =
+            (char *)calloc(terminal_count, sizeof(char));
+        if (self->empty_follows[production_index] == NULL) {
+            abort();
+        }
+    }
+
+    self->empty_follows[production_index][terminal_index] = 1;
+}
+
+
+/* How a production reduces once nonterminals are inlined into it */
+struct folding
+{
+    /* The production as it was written, whose reduction gets the
+     * values of the inlined nonterminals */
+    production_t parent;
+
+    /* The production inlined at each position of the parent's
+     * right-hand side, or NULL where the component was kept */
+    production_t *children;
+
+    /* The name of the function which performs all of the reductions */
+    char *reduction;
+};
+
+/* Releases the resources consumed by the folding */
+static void
+folding_free(struct folding *self)
+{
+    production_free(self->parent);
+    free(self->children);
+    free(self->reduction);
+    free(self);
+}
+
 
 /* The organization of the grammar */
 struct grammar
@@ -195,11 +284,37 @@ struct grammar
      * nonterminal[generated]. */
     char **generates;
 
+    /* The nullable table.  Once initialized, nullable[nonterminal]
+     * will be nonzero if the nonterminal can derive the empty string. */
+    char *nullable;
+
     /* The number of kernels in the receiver */
     int kernel_count;
 
     /* The kernels */
     kernel_t *kernels;
+
+    /* The number of entry points */
+    int start_count;
+
+    /* The production by which each entry point accepts, starting with
+     * the first production */
+    int *starts;
+
+    /* The kernel in which each entry point begins */
+    int *start_kernels;
+
+    /* The number of conflicts which weren't settled by precedence */
+    int conflict_count;
+
+    /* How each production folds in the reductions of the nonterminals
+     * inlined into it, indexed by production.  NULL until something
+     * is inlined, and NULL for each production left as written. */
+    struct folding **foldings;
+
+    /* Where to report problems with the grammar, or NULL to keep
+     * quiet about them */
+    sink_t log;
 };
 
 
@@ -274,10 +389,11 @@ verify_productions_by_nonterminal(grammar_t self)
             char *filename;
             line = component_get_origin(self->nonterminals[index], &filename);
 
-            fprintf(stderr, "%s:%d: no rule to generate ",
-                    filename ? filename : "[stdin]", line);
-            component_print(self->nonterminals[index], stderr);
-            fprintf(stderr, "\n");
+            sink_printf(self->log, "%s:%d: no rule to generate ",
+                        filename ? filename : "[stdin]", line);
+            component_print(self->nonterminals[index], self->log);
+            sink_puts(self->log, "\n");
+            sink_flush(self->log);
             result = -1;
         }
     }
@@ -285,6 +401,221 @@ verify_productions_by_nonterminal(grammar_t self)
     return result;
 }
 
+/* Returns nonzero if every component of the production is a terminal
+ * or one of the nonterminals marked in the table */
+static int
+production_uses_only(production_t production, const char *table)
+{
+    component_t component;
+    int offset = 0;
+
+    while ((component = production_get_component(
+                production, offset++)) != NULL) {
+        if (component_is_nonterminal(component) &&
+            ! table[component_get_index(component)]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Warns that the nonterminal is being dropped and why */
+static void
+report_useless(grammar_t self, component_t nonterminal, const char *why)
+{
+    char *filename;
+    int line = component_get_origin(nonterminal, &filename);
+
+    sink_printf(self->log, "%s:%d: warning: dropping ",
+                filename ? filename : "[stdin]", line);
+    component_print(nonterminal, self->log);
+    sink_printf(self->log, "which %s\n", why);
+}
+
+/* Drops the nonterminals which derive no string of terminals or which
+ * can't be reached from any entry point, along with every production
+ * which mentions them, before they cost any states.  Returns -1 if
+ * an entry point's production is one of them. */
+static int
+prune_useless(grammar_t self)
+{
+    char *productive;
+    char *reachable;
+    int *renumber;
+    int changed;
+    int count;
+    int i, j;
+
+    productive = (char *)calloc(self->nonterminal_count, sizeof(char));
+    reachable = (char *)calloc(self->nonterminal_count, sizeof(char));
+    renumber = (int *)malloc(self->nonterminal_count * sizeof(int));
+    if (productive == NULL || reachable == NULL || renumber == NULL) {
+        free(productive);
+        free(reachable);
+        free(renumber);
+        return -1;
+    }
+
+    /* Leave a nonterminal with no rule at all to be reported as such */
+    for (i = 0; i < self->production_count; i++) {
+        reachable[production_get_nonterminal_index(
+            self->productions[i])] = 1;
+    }
+
+    for (i = 0; i < self->nonterminal_count; i++) {
+        if (! reachable[i]) {
+            free(productive);
+            free(reachable);
+            free(renumber);
+            return 0;
+        }
+
+        reachable[i] = 0;
+    }
+
+    /* A nonterminal is productive if one of its productions uses only
+     * terminals and productive nonterminals */
+    changed = 1;
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < self->production_count; i++) {
+            production_t production = self->productions[i];
+            int nonterminal = production_get_nonterminal_index(production);
+
+            if (! productive[nonterminal] &&
+                production_uses_only(production, productive)) {
+                productive[nonterminal] = 1;
+                changed = 1;
+            }
+        }
+    }
+
+    /* Then it's reachable if it appears in a productive production of
+     * a reachable nonterminal */
+    for (i = 0; i < self->start_count; i++) {
+        reachable[production_get_nonterminal_index(
+            self->productions[self->starts[i]])] = 1;
+    }
+
+    changed = 1;
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < self->production_count; i++) {
+            production_t production = self->productions[i];
+            component_t component;
+            int offset = 0;
+
+            if (! reachable[production_get_nonterminal_index(production)] ||
+                ! production_uses_only(production, productive)) {
+                continue;
+            }
+
+            while ((component = production_get_component(
+                        production, offset++)) != NULL) {
+                if (component_is_nonterminal(component) &&
+                    ! reachable[component_get_index(component)]) {
+                    reachable[component_get_index(component)] = 1;
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    /* There's nothing to accept if an entry point is useless */
+    for (i = 0; i < self->start_count; i++) {
+        production_t production = self->productions[self->starts[i]];
+
+        if (! production_uses_only(production, productive)) {
+            sink_printf(self->log, "*** Error: the %s production "
+                        "derives no string of terminals\n  ",
+                        i == 0 ? "first" : "%start");
+            production_print(production, self->log);
+            sink_puts(self->log, "\n");
+            sink_flush(self->log);
+            free(productive);
+            free(reachable);
+            free(renumber);
+            return -1;
+        }
+    }
+
+    /* Renumber the useful nonterminals */
+    count = 0;
+    for (i = 0; i < self->nonterminal_count; i++) {
+        component_t nonterminal = self->nonterminals[i];
+
+        if (! productive[i]) {
+            report_useless(self, nonterminal,
+                           "derives no string of terminals");
+        } else if (! reachable[i]) {
+            report_useless(self, nonterminal,
+                           "can't be reached from any entry point");
+        } else {
+            renumber[i] = count++;
+            continue;
+        }
+
+        renumber[i] = -1;
+    }
+
+    /* Drop the productions which mention the others */
+    changed = count != self->nonterminal_count;
+    count = 0;
+    for (i = 0; i < self->production_count; i++) {
+        production_t production = self->productions[i];
+        int nonterminal = production_get_nonterminal_index(production);
+
+        if (reachable[nonterminal] &&
+            production_uses_only(production, productive)) {
+            for (j = 0; j < self->start_count; j++) {
+                if (self->starts[j] == i) {
+                    self->starts[j] = count;
+                }
+            }
+
+            production_set_index(production, count);
+            self->productions[count++] = production;
+            continue;
+        }
+
+        /* Those of a dropped nonterminal go without saying */
+        if (! (renumber[nonterminal] < 0)) {
+            sink_puts(self->log,
+                      "*** Warning: dropping useless production ");
+            production_print(production, self->log);
+            sink_puts(self->log, "\n");
+        }
+
+        production_free(production);
+        changed = 1;
+    }
+
+    self->production_count = count;
+    sink_flush(self->log);
+
+    /* Renumber the nonterminals which are left */
+    if (changed) {
+        count = 0;
+        for (i = 0; i < self->nonterminal_count; i++) {
+            if (renumber[i] < 0) {
+                component_free(self->nonterminals[i]);
+                continue;
+            }
+
+            component_set_index(self->nonterminals[i], count);
+            self->nonterminals[count++] = self->nonterminals[i];
+        }
+
+        self->nonterminal_count = count;
+    }
+
+    free(productive);
+    free(reachable);
+    free(renumber);
+    return 0;
+}
+
 /* Indicate that the nonterminal `generator' spontaneously generates
  * the nonterminal `generated' in the grammar */
 static void
@@ -337,12 +668,58 @@ compute_generates(grammar_t self)
         int nonterminal = production_get_nonterminal_index(production);
         component_t component = production_get_component(production, 0);
 
-        if (component_is_nonterminal(component)) {
+        if (component != NULL && component_is_nonterminal(component)) {
             mark_generates(self, nonterminal, component_get_index(component));
         }
     }
 }
 
+/* Constructs the `nullable' table */
+static int
+compute_nullable(grammar_t self)
+{
+    int changed;
+    int index;
+
+    /* Create the `nullable' table */
+    self->nullable = (char *)calloc(self->nonterminal_count, sizeof(char));
+    if (self->nullable == NULL) {
+        return -1;
+    }
+
+    /* A nonterminal is nullable if one of its productions consists
+     * only of nullable nonterminals, so keep going until no more
+     * nonterminals turn out to be nullable */
+    changed = 1;
+    while (changed) {
+        changed = 0;
+        for (index = 0; index < self->production_count; index++) {
+            production_t production = self->productions[index];
+            int nonterminal = production_get_nonterminal_index(production);
+            component_t component;
+            int offset = 0;
+
+            if (self->nullable[nonterminal]) {
+                continue;
+            }
+
+            while ((component = production_get_component(
+                        production, offset)) != NULL &&
+                   component_is_nonterminal(component) &&
+                   self->nullable[component_get_index(component)]) {
+                offset++;
+            }
+
+            if (component == NULL) {
+                self->nullable[nonterminal] = 1;
+                changed = 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 /* Encode a production number and offset in a single integer. */
 static int
 encode(grammar_t self, int index, int offset)
@@ -359,6 +736,65 @@ decode(grammar_t self, int code, int *index_out)
 }
 
 
+/* Kernel actions are encoded as ERR_ACTION, ACC_ACTION, the index of
+ * the production to reduce or a kernel index offset by the number of
+ * productions for a shift */
+#define ERR_ACTION -1
+#define ACC_ACTION 0
+
+/* Encodes a shift to the given kernel as an action */
+static int
+shift_action(grammar_t self, int kernel_index)
+{
+    return self->production_count + kernel_index;
+}
+
+/* Returns nonzero if the action is a shift */
+static int
+action_is_shift(grammar_t self, int action)
+{
+    return self->production_count <= action;
+}
+
+/* Returns nonzero if the production is how an entry point accepts */
+static int
+is_start_production(grammar_t self, int production_index)
+{
+    int i;
+
+    for (i = 0; i < self->start_count; i++) {
+        if (self->starts[i] == production_index) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Returns nonzero if the action is a reduction (other than accept) */
+static int
+action_is_reduce(grammar_t self, int action)
+{
+    return 0 < action && action < self->production_count &&
+        ! is_start_production(self, action);
+}
+
+/* Returns nonzero if the action accepts at one of the entry points */
+static int
+action_is_accept(grammar_t self, int action)
+{
+    return ! (action < 0) && action < self->production_count &&
+        is_start_production(self, action);
+}
+
+/* Returns the kernel to which a shift action moves */
+static int
+action_shift_target(grammar_t self, int action)
+{
+    return action - self->production_count;
+}
+
+
 /* Locates or creates a kernel for the given goto pairs and returns
  * its index */
 int
@@ -470,6 +906,11 @@ compute_pairs_for_kernel_item(grammar_t self,
             for (probe = self->productions_by_nonterminal[i];
                  *probe != NULL;
                  probe++) {
+                /* Empty productions don't go anywhere */
+                if (production_get_count(*probe) == 0) {
+                    continue;
+                }
+
                 add_pairs_entry(
                     counts, table,
                     component_index(self, production_get_component(*probe, 0)),
@@ -530,10 +971,12 @@ compute_LR0_kernels(grammar_t self)
     int *goto_table;
     int i, j;
 
-    /* Construct the first kernel to seed the table */
-    pairs = (int *)malloc(sizeof(int));
-    pairs[0] = encode(self, 0, 0);
-    intern_kernel(self, 1, pairs);
+    /* Construct a kernel for each entry point to seed the table */
+    for (i = 0; i < self->start_count; i++) {
+        pairs = (int *)malloc(sizeof(int));
+        pairs[0] = encode(self, self->starts[i], 0);
+        self->start_kernels[i] = intern_kernel(self, 1, pairs);
+    }
 
     /* Allocate some room for the goto table */
     pairs_counts = (int *)calloc(count, sizeof(int *));
@@ -586,18 +1029,25 @@ mark_firsts_with_table(grammar_t self,
         /* Try this production if we haven't already done so */
         if (! tried[pi]) {
             component_t component;
+            int offset = 0;
 
             /* Indicate that we've now tried this production rule */
             tried[pi] = 1;
 
-            /* Look up the first component of the production */
-            component = production_get_component(*probe, 0);
-            if (component_is_nonterminal(component)) {
+            /* Look through the components until one can't be empty */
+            while ((component = production_get_component(
+                        *probe, offset++)) != NULL) {
+                if (! component_is_nonterminal(component)) {
+                    /* Just add the terminal symbol */
+                    table[component_get_index(component)] = 1;
+                    break;
+                }
+
                 /* Recursively add the first elements of the nonterminal */
                 mark_firsts_with_table(self, component, table, tried);
-            } else {
-                /* Just add the terminal symbol */
-                table[component_get_index(component)] = 1;
+                if (! self->nullable[component_get_index(component)]) {
+                    break;
+                }
             }
         }
     }
@@ -616,6 +1066,30 @@ mark_firsts(grammar_t self, component_t nonterminal, char *table)
     free(tried);
 }
 
+/* Marks the terminals which can appear first in the production from
+ * the given offset onwards.  Returns nonzero if that can be empty. */
+static int
+mark_suffix_firsts(grammar_t self, production_t production, int offset,
+                   char *table)
+{
+    component_t component;
+
+    while ((component = production_get_component(
+                production, offset++)) != NULL) {
+        if (! component_is_nonterminal(component)) {
+            table[component_get_index(component)] = 1;
+            return 0;
+        }
+
+        mark_firsts(self, component, table);
+        if (! self->nullable[component_get_index(component)]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
 /* Forward declaration */
 static int
 compute_propagates_for_production_and_offset(grammar_t self,
@@ -668,8 +1142,10 @@ compute_propagates_for_production_and_offset(grammar_t self,
     component_t next;
     int pi = production_get_index(production);
 
-    /* If there is no next component then we're done */
-    if ((component = production_get_component(production, offset)) == NULL) {
+    /* If there is no next component then we're done, unless this is
+     * an empty production whose follows set we need to know */
+    component = production_get_component(production, offset);
+    if (component == NULL && offset != 0) {
         return 0;
     }
 
@@ -690,11 +1166,6 @@ compute_propagates_for_production_and_offset(grammar_t self,
         int ti = component_get_index(terminal);
         int code;
 
-        /* Figure out which kernel this belongs in */
-        target = self->kernels[kernel->goto_table[component_index(self,
-                                                                  component)]];
-        code = encode(self, pi, offset + 1);
-
         /* See if we've already done this one */
         if (table[ti + pi * self->terminal_count]) {
             return 0;
@@ -703,12 +1174,24 @@ compute_propagates_for_production_and_offset(grammar_t self,
         /* Mark this production */
         table[ti + pi * self->terminal_count] = 1;
 
+        /* An empty production is reduced right here */
+        if (component == NULL) {
+            kernel_set_empty_follows(kernel, self->production_count, pi,
+                                     self->terminal_count, ti);
+            return 0;
+        }
+
+        /* Figure out which kernel this belongs in */
+        target = self->kernels[kernel->goto_table[component_index(self,
+                                                                  component)]];
+        code = encode(self, pi, offset + 1);
+
         /* Put the terminal in the follows set of the destination */
         kernel_set_follows(target, code, ti);
     }
 
     /* If the component is a terminal then there's nothing else to do */
-    if (! component_is_nonterminal(component)) {
+    if (component == NULL || ! component_is_nonterminal(component)) {
         return 0;
     }
 
@@ -722,6 +1205,7 @@ compute_propagates_for_production_and_offset(grammar_t self,
     /* If it's a nonterminal then things are complicated */
     if (next != NULL && component_is_nonterminal(next)) {
         char *firsts;
+        int nullable;
         int index;
 
         /* Allocate some room for the `firsts' table */
@@ -731,8 +1215,8 @@ compute_propagates_for_production_and_offset(grammar_t self,
         }
 
         /* Determine what terminals may occupy the first position in
-         * the nonterminal */
-        mark_firsts(self, next, firsts);
+         * the rest of the production */
+        nullable = mark_suffix_firsts(self, production, offset + 1, firsts);
 
         /* Go through the firsts set and add it to the follows set of
          * our target */
@@ -746,6 +1230,12 @@ compute_propagates_for_production_and_offset(grammar_t self,
             }
         }
 
+        /* If the rest can be empty then so can what follows it */
+        if (nullable) {
+            propagate_derived(self, kernel, component, terminal,
+                              propagates, table);
+        }
+
         /* Clean up */
         free(firsts);
         return 0;
@@ -884,8 +1374,10 @@ compute_propagates(grammar_t self)
         compute_propagates_for_kernel(self, self->kernels[index]);
     }
 
-    /* Inject the <EOF> terminal into the start kernel's production */
-    self->kernels[0]->follows_table[0][0] = 1;
+    /* Inject the <EOF> terminal into each start kernel's production */
+    for (index = 0; index < self->start_count; index++) {
+        self->kernels[self->start_kernels[index]]->follows_table[0][0] = 1;
+    }
 
     /* Move stuff around until things stop changing */
     changed = 1;
@@ -896,21 +1388,353 @@ compute_propagates(grammar_t self)
 
     return 0;
 }
+/* Forward declaration */
+void print_kernel(grammar_t self, int index, sink_t out);
+
+/* Returns the index of the first production in the kernel to be
+ * listed in the input file */
+static int
+first_production_index(grammar_t self, kernel_t kernel)
+{
+    int index;
+    int result = self->production_count;
 
+    /* Go through the pairs and find the first listed production */
+    for (index = 0; index < kernel->count; index++) {
+        int test;
 
+        decode(self, kernel->pairs[index], &test);
+        if (test < result) {
+            result = test;
+        }
+    }
 
+    return result;
+}
 
-/* Allocates and initializes a new nonterminal grammar_t */
-grammar_t
-grammar_alloc(int production_count, production_t *productions,
-              int terminal_count, component_t *terminals,
-              int nonterminal_count, component_t *nonterminals)
+/* Resolves a conflict between shifting the terminal and reducing by
+ * the production by comparing their declared precedences, storing
+ * the chosen action in action_out.  Returns 0 if either has no
+ * precedence, in which case the conflict stands. */
+static int
+resolve_by_precedence(grammar_t self, int reduction, int terminal,
+                      int shift, int *action_out)
 {
-    grammar_t self;
+    component_t operator;
+    associativity_t associativity;
+    int shift_level, reduce_level;
+
+    /* The production takes the precedence of its operator */
+    operator = production_get_precedence(self->productions[reduction]);
+    if (operator == NULL ||
+        (reduce_level = component_get_precedence(
+            operator, &associativity)) == 0 ||
+        (shift_level = component_get_precedence(
+            self->terminals[terminal], &associativity)) == 0) {
+        return 0;
+    }
 
-    /* Allocate space for a new grammar_t */
-    if ((self = (grammar_t)malloc(sizeof(struct grammar))) == NULL) {
-        return NULL;
+    /* The tighter binding wins; ties go by the terminal's associativity */
+    if (reduce_level > shift_level ||
+        (reduce_level == shift_level && associativity == ASSOC_LEFT)) {
+        *action_out = reduction;
+    } else if (reduce_level < shift_level ||
+               associativity == ASSOC_RIGHT) {
+        *action_out = shift_action(self, shift);
+    } else {
+        *action_out = ERR_ACTION;
+    }
+
+    return 1;
+}
+
+/* Works out the follows set of an empty production in the kernel's
+ * closure from its spontaneous follows and those of the kernel items
+ * which propagate to it.  Returns nonzero if the set isn't empty. */
+static int
+compute_empty_follows(grammar_t self, kernel_t kernel, int production_index,
+                      char *follows)
+{
+    int result = 0;
+    int i, j;
+
+    for (i = 0; i < self->terminal_count; i++) {
+        follows[i] = kernel->empty_follows != NULL &&
+            kernel->empty_follows[production_index] != NULL &&
+            kernel->empty_follows[production_index][i];
+
+        for (j = 0; j < kernel->count && ! follows[i]; j++) {
+            follows[i] = kernel->propagates_table[j][production_index] &&
+                kernel->follows_table[j][i];
+        }
+
+        result |= follows[i];
+    }
+
+    return result;
+}
+
+/* Records a reduction by the production on each terminal in the
+ * follows set, reporting reduce/reduce conflicts */
+static void
+add_reductions(grammar_t self, int kernel_index, int production_index,
+               char *follows, int *reductions)
+{
+    int i;
+
+    /* Traverse the follows set */
+    for (i = 0; i < self->terminal_count; i++) {
+        if (follows[i] && reductions[i] != production_index) {
+            if (reductions[i] == -1) {
+                reductions[i] = production_index;
+                continue;
+            }
+
+            /* Report reduce/reduce conflicts */
+            self->conflict_count++;
+            if (self->log != NULL) {
+                sink_puts(self->log,
+                          "*** Warning: reduce/reduce conflict on ");
+                component_print(self->terminals[i], self->log);
+                sink_printf(self->log, "in kernel %d\n", kernel_index);
+                sink_puts(self->log,
+                          "  [using first listed reduction]\n");
+                print_kernel(self, kernel_index, self->log);
+                sink_flush(self->log);
+            }
+        }
+    }
+}
+
+/* Works out the kernel's action for each terminal, reporting and
+ * resolving any conflicts along the way */
+static int
+compute_kernel_actions(grammar_t self, int kernel_index)
+{
+    kernel_t kernel = self->kernels[kernel_index];
+    int *reductions;
+    char *follows;
+    int index;
+
+    /* Create a table in which to record the reductions */
+    reductions = (int *)malloc(self->terminal_count * sizeof(int));
+    if (reductions == NULL) {
+        return -1;
+    }
+
+    memset(reductions, -1, self->terminal_count * sizeof(int));
+
+    /* And another for the actions themselves */
+    kernel->actions = (int *)malloc(self->terminal_count * sizeof(int));
+    if (kernel->actions == NULL) {
+        free(reductions);
+        return -1;
+    }
+
+    /* And one for the follows sets of empty productions */
+    follows = (char *)malloc(self->terminal_count * sizeof(char));
+    if (follows == NULL) {
+        free(reductions);
+        return -1;
+    }
+
+    /* Populate the reductions table */
+    for (index = 0; index < kernel->count; index++) {
+        int pi;
+        int offset = decode(self, kernel->pairs[index], &pi);
+        production_t production = self->productions[pi];
+
+        /* We reduce on the follow set if we're the end of the production */
+        if (production_get_component(production, offset) == NULL) {
+            add_reductions(self, kernel_index, pi,
+                           kernel->follows_table[index], reductions);
+        }
+    }
+
+    /* Empty productions in the closure are reduced right away */
+    for (index = 0; index < self->production_count; index++) {
+        if (production_get_count(self->productions[index]) == 0 &&
+            compute_empty_follows(self, kernel, index, follows)) {
+            add_reductions(self, kernel_index, index, follows, reductions);
+        }
+    }
+
+    /* Decide what to do with each terminal */
+    for (index = 0; index < self->terminal_count; index++) {
+        int ki = kernel->goto_table[self->nonterminal_count + index];
+        int shift = (ki < 0) ? 0 : ki;
+        int reduction = reductions[index];
+
+        /* Let declared precedences settle a shift/reduce conflict */
+        if (shift != 0 && reduction != -1 &&
+            resolve_by_precedence(self, reduction, index, shift,
+                                  &kernel->actions[index])) {
+            continue;
+        }
+
+        /* See if there's a shift action for this terminal */
+        if (shift != 0) {
+            /* Report shift/reduce conflicts */
+            if (reduction != -1) {
+                int si;
+
+                /* Resolve the conflict according to the order of the
+                 * productions in the grammar.  Figure out which
+                 * production generated the shift operation */
+                si = first_production_index(self, self->kernels[shift]);
+                if (reduction < si) {
+                    kernel->actions[index] = reduction;
+                } else {
+                    kernel->actions[index] = shift_action(self, shift);
+                }
+
+                self->conflict_count++;
+                if (self->log != NULL) {
+                    sink_puts(self->log,
+                              "*** Warning: shift/reduce conflict on ");
+                    component_print(self->terminals[index], self->log);
+                    sink_printf(self->log, "in kernel %d\n", kernel_index);
+                    sink_puts(self->log, reduction < si ?
+                              "    [choosing to reduce]\n" :
+                              "    [choosing to shift]\n");
+
+                    /* Print the kernel for reference */
+                    print_kernel(self, kernel_index, self->log);
+                    sink_flush(self->log);
+                }
+            } else {
+                kernel->actions[index] = shift_action(self, shift);
+            }
+        } else if (reduction < 0) {
+            kernel->actions[index] = ERR_ACTION;
+        } else {
+            /* Reducing by an entry point's production is accepting */
+            kernel->actions[index] = reduction;
+        }
+    }
+
+    /* Clean up */
+    free(reductions);
+    free(follows);
+    return 0;
+}
+
+/* Computes the shift/reduce actions of every kernel */
+static int
+compute_actions(grammar_t self)
+{
+    int index;
+
+    for (index = 0; index < self->kernel_count; index++) {
+        if (compute_kernel_actions(self, index) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+/* Works out the receiver's kernels and their actions from its
+ * productions */
+static int
+compute_automaton(grammar_t self)
+{
+    /* Compute the productions_by_nonterminal */
+    if ((self->productions_by_nonterminal =
+         compute_productions_by_nonterminal(
+             self->nonterminal_count,
+             self->production_count,
+             self->productions)) == NULL) {
+        return -1;
+    }
+
+    /* Make sure that every nonterminal has at least on production that generates it. */
+    if (verify_productions_by_nonterminal(self) < 0) {
+        return -1;
+    }
+
+    /* Compute the `generates' table */
+    compute_generates(self);
+
+    /* Work out which nonterminals can be empty */
+    if (compute_nullable(self) < 0) {
+        return -1;
+    }
+
+    /* Compute the LR(0) kernels */
+    if (compute_LR0_kernels(self) < 0) {
+        return -1;
+    }
+
+    /* Compute the propagation table */
+    compute_propagates(self);
+
+    /* Work out the shift/reduce table */
+    return compute_actions(self);
+}
+
+/* Releases everything compute_automaton() worked out */
+static void
+discard_automaton(grammar_t self)
+{
+    int index;
+
+    if (self->productions_by_nonterminal != NULL) {
+        for (index = 0; index < self->nonterminal_count; index++) {
+            if (self->productions_by_nonterminal[index] != NULL) {
+                free(self->productions_by_nonterminal[index]);
+            }
+        }
+
+        free(self->productions_by_nonterminal);
+        self->productions_by_nonterminal = NULL;
+    }
+
+    if (self->generates != NULL) {
+        for (index = 0; index < self->nonterminal_count; index++) {
+            if (self->generates[index] != NULL) {
+                free(self->generates[index]);
+            }
+        }
+
+        free(self->generates);
+        self->generates = NULL;
+    }
+
+    if (self->nullable != NULL) {
+        free(self->nullable);
+        self->nullable = NULL;
+    }
+
+    if (self->kernels != NULL) {
+        for (index = 0; index < self->kernel_count; index++) {
+            kernel_free(self->kernels[index], self->production_count);
+        }
+
+        free(self->kernels);
+        self->kernels = NULL;
+    }
+
+    self->kernel_count = 0;
+    self->conflict_count = 0;
+}
+
+/* Allocates and initializes a new nonterminal grammar_t */
+grammar_t
+grammar_alloc(int production_count, production_t *productions,
+              int terminal_count, component_t *terminals,
+              int nonterminal_count, component_t *nonterminals,
+              int start_count, int *starts)
+{
+    grammar_t self;
+    int index;
+
+    /* Allocate space for a new grammar_t */
+    if ((self = (grammar_t)malloc(sizeof(struct grammar))) == NULL) {
+        return NULL;
     }
 
     /* Initialize its contents to sane values */
@@ -922,37 +1746,40 @@ grammar_alloc(int production_count, production_t *productions,
     self->nonterminals = nonterminals;
     self->productions_by_nonterminal = NULL;
     self->generates = NULL;
+    self->nullable = NULL;
     self->kernel_count = 0;
     self->kernels = NULL;
-
-    /* Compute the productions_by_nonterminal */
-    if ((self->productions_by_nonterminal =
-         compute_productions_by_nonterminal(
-             nonterminal_count,
-             production_count,
-             productions)) == NULL) {
+    self->start_count = start_count + 1;
+    self->starts = NULL;
+    self->start_kernels = NULL;
+    self->conflict_count = 0;
+    self->foldings = NULL;
+
+    /* Problems are reported on stderr */
+    if ((self->log = sink_alloc(stderr)) == NULL) {
         grammar_free(self);
         return NULL;
     }
 
-    /* Make sure that every nonterminal has at least on production that generates it. */
-    if (verify_productions_by_nonterminal(self) < 0) {
+    /* The first production is always the first entry point */
+    self->starts = (int *)malloc(self->start_count * sizeof(int));
+    self->start_kernels = (int *)malloc(self->start_count * sizeof(int));
+    if (self->starts == NULL || self->start_kernels == NULL) {
         grammar_free(self);
         return NULL;
     }
 
-    /* Compute the `generates' table */
-    compute_generates(self);
+    self->starts[0] = 0;
+    for (index = 0; index < start_count; index++) {
+        self->starts[index + 1] = starts[index];
+    }
 
-    /* Compute the LR(0) kernels */
-    if (compute_LR0_kernels(self) < 0) {
+    /* Drop what can't be used and build the automaton from the rest */
+    if (prune_useless(self) < 0 || compute_automaton(self) < 0) {
         grammar_free(self);
         return NULL;
     }
 
-    /* Compute the propagation table */
-    compute_propagates(self);
-
     return self;
 }
 
@@ -962,6 +1789,18 @@ grammar_free(grammar_t self)
 {
     int index;
 
+    discard_automaton(self);
+
+    if (self->foldings != NULL) {
+        for (index = 0; index < self->production_count; index++) {
+            if (self->foldings[index] != NULL) {
+                folding_free(self->foldings[index]);
+            }
+        }
+
+        free(self->foldings);
+    }
+
     if (self->productions != NULL) {
         for (index = 0; index < self->production_count; index++) {
             production_free(self->productions[index]);
@@ -982,6 +1821,18 @@ grammar_free(grammar_t self)
         }
     }
 
+    if (self->starts != NULL) {
+        free(self->starts);
+    }
+
+    if (self->start_kernels != NULL) {
+        free(self->start_kernels);
+    }
+
+    if (self->log != NULL) {
+        sink_free(self->log);
+    }
+
     free(self);
 }
 
@@ -992,386 +1843,2566 @@ grammar_get_component_count(grammar_t self)
     return self->terminal_count + self->nonterminal_count;
 }
 
+/* Returns the number of kernels (states) in the grammar */
+int
+grammar_get_kernel_count(grammar_t self)
+{
+    return self->kernel_count;
+}
 
-/* Prints a single kernel */
-void
-print_kernel(grammar_t self, int index, FILE *out)
+/* Returns the number of entry points into the grammar */
+int
+grammar_get_start_count(grammar_t self)
 {
-    kernel_t kernel = self->kernels[index];
-    int i;
+    return self->start_count;
+}
 
-    fprintf(out, "Kernel %d\n", index);
-    for (i = 0; i < kernel->count; i++) {
-        int first = 1;
-        int pi;
-        int j;
+/* A kernel's place in the profile */
+struct visits
+{
+    /* The number of times the kernel was visited */
+    unsigned long count;
 
-        int offset = decode(self, kernel->pairs[i], &pi);
-        fprintf(out, " %d: ", i);
-        production_print_with_offset(self->productions[pi], out, offset);
+    /* The kernel's index */
+    int index;
+};
 
-        for (j = 0; j < self->terminal_count; j++) {
-            if (kernel->follows_table[i][j]) {
-                if (first) {
-                    fprintf(out, ", ");
-                    first = 0;
-                } else {
-                    fprintf(out, "/ ");
-                }
+/* Orders kernels by descending visits and then by index */
+static int
+compare_visits(const void *a, const void *b)
+{
+    const struct visits *x = (const struct visits *)a;
+    const struct visits *y = (const struct visits *)b;
 
-                component_print(self->terminals[j], out);
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+
+    return x->index - y->index;
+}
+
+/* Renumbers the kernels in order of descending visits */
+int
+grammar_renumber_kernels(grammar_t self, const unsigned long *visits,
+                         int count)
+{
+    struct visits *order;
+    kernel_t *kernels;
+    int *renumber;
+    int i, j;
+
+    order = (struct visits *)malloc(
+        self->kernel_count * sizeof(struct visits));
+    renumber = (int *)malloc(self->kernel_count * sizeof(int));
+    kernels = (kernel_t *)malloc(self->kernel_count * sizeof(kernel_t));
+    if (order == NULL || renumber == NULL || kernels == NULL) {
+        free(order);
+        free(renumber);
+        free(kernels);
+        return -1;
+    }
+
+    /* Sort the kernels, keeping the initial one first */
+    for (i = 0; i < self->kernel_count; i++) {
+        order[i].count = i < count ? visits[i] : 0;
+        order[i].index = i;
+    }
+
+    qsort(order + 1, self->kernel_count - 1, sizeof(struct visits),
+          compare_visits);
+
+    for (i = 0; i < self->kernel_count; i++) {
+        renumber[order[i].index] = i;
+        kernels[i] = self->kernels[order[i].index];
+    }
+
+    /* Point the gotos and shifts at the new numbers */
+    for (i = 0; i < self->kernel_count; i++) {
+        kernel_t kernel = kernels[i];
+
+        for (j = 0; j < self->nonterminal_count + self->terminal_count; j++) {
+            if (! (kernel->goto_table[j] < 0)) {
+                kernel->goto_table[j] = renumber[kernel->goto_table[j]];
             }
         }
 
-        fprintf(out, "\n");
+        for (j = 0; j < self->terminal_count; j++) {
+            if (action_is_shift(self, kernel->actions[j])) {
+                kernel->actions[j] = shift_action(
+                    self,
+                    renumber[action_shift_target(self, kernel->actions[j])]);
+            }
+        }
     }
 
-    /* Print out the goto table's nonterminals */
+    for (i = 0; i < self->start_count; i++) {
+        self->start_kernels[i] = renumber[self->start_kernels[i]];
+    }
+
+    free(self->kernels);
+    self->kernels = kernels;
+    free(order);
+    free(renumber);
+    return 0;
+}
+
+/* Returns the unit production by which the kernel reduces on every
+ * terminal it doesn't reject, if that's all it ever does and the
+ * production is marked in bypass, otherwise -1 */
+static int
+unit_kernel_production(grammar_t self, kernel_t kernel, const char *bypass)
+{
+    int result = -1;
+    int i;
+
+    /* Only a kernel with nowhere to go can be skipped */
     for (i = 0; i < self->nonterminal_count; i++) {
         if (! (kernel->goto_table[i] < 0)) {
-            fprintf(out, "    ");
-            component_print(self->nonterminals[i], out);
-            fprintf(out, ": %d\n", kernel->goto_table[i]);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < self->terminal_count; i++) {
+        int action = kernel->actions[i];
+
+        if (action == ERR_ACTION) {
+            continue;
+        }
+
+        if (! action_is_reduce(self, action) || ! bypass[action] ||
+            (result != -1 && action != result)) {
+            return -1;
+        }
+
+        result = action;
+    }
+
+    return result;
+}
+
+/* Answers the kernel to enter in place of the target after a shift
+ * or goto from the kernel, skipping any unit reductions */
+static int
+bypass_target(grammar_t self, kernel_t kernel, int *units, int target)
+{
+    int count = 0;
+
+    /* Reducing by a unit production pops back to this kernel and then
+     * goes to its left-hand side, so go straight there instead */
+    while (units[target] != -1 && count++ < self->kernel_count) {
+        target = kernel->goto_table[production_get_nonterminal_index(
+            self->productions[units[target]])];
+    }
+
+    return target;
+}
+
+/* Gives each kernel the number in renumber, dropping it if that's -1
+ * or if an earlier kernel already has the number.  The numbers must
+ * count up from 0 in the order they first appear. */
+static void
+merge_kernels(grammar_t self, int *renumber)
+{
+    int count = 0;
+    int i, j;
+
+    for (i = 0; i < self->kernel_count; i++) {
+        if (renumber[i] == count) {
+            self->kernels[count++] = self->kernels[i];
+        } else {
+            kernel_free(self->kernels[i], self->production_count);
+        }
+    }
+
+    self->kernel_count = count;
+    for (i = 0; i < self->start_count; i++) {
+        self->start_kernels[i] = renumber[self->start_kernels[i]];
+    }
+
+    /* Point the gotos and shifts at the new numbers */
+    for (i = 0; i < self->kernel_count; i++) {
+        kernel_t kernel = self->kernels[i];
+
+        for (j = 0; j < self->nonterminal_count + self->terminal_count; j++) {
+            if (! (kernel->goto_table[j] < 0)) {
+                kernel->goto_table[j] = renumber[kernel->goto_table[j]];
+            }
+        }
+
+        for (j = 0; j < self->terminal_count; j++) {
+            if (action_is_shift(self, kernel->actions[j])) {
+                kernel->actions[j] = shift_action(
+                    self,
+                    renumber[action_shift_target(self, kernel->actions[j])]);
+            }
+        }
+    }
+}
+
+/* Drops any kernels which can no longer be reached from the initial
+ * kernel, renumbering the rest */
+static int
+remove_unreachable_kernels(grammar_t self)
+{
+    int *renumber;
+    int *stack;
+    int count = 0;
+    int top = 0;
+    int i, j;
+
+    renumber = (int *)malloc(self->kernel_count * sizeof(int));
+    stack = (int *)malloc(self->kernel_count * sizeof(int));
+    if (renumber == NULL || stack == NULL) {
+        free(renumber);
+        free(stack);
+        return -1;
+    }
+
+    /* Mark every kernel reachable by a shift or goto from one of the
+     * entry points */
+    for (i = 0; i < self->kernel_count; i++) {
+        renumber[i] = -1;
+    }
+
+    for (i = 0; i < self->start_count; i++) {
+        if (renumber[self->start_kernels[i]] < 0) {
+            renumber[self->start_kernels[i]] = 0;
+            stack[top++] = self->start_kernels[i];
+        }
+    }
+    while (top > 0) {
+        kernel_t kernel = self->kernels[stack[--top]];
+
+        for (j = 0; j < self->nonterminal_count + self->terminal_count; j++) {
+            int target = kernel->goto_table[j];
+
+            /* A terminal's goto only counts if we chose to shift it */
+            if (! (j < self->nonterminal_count) &&
+                ! action_is_shift(
+                    self, kernel->actions[j - self->nonterminal_count])) {
+                continue;
+            }
+
+            if (! (target < 0) && renumber[target] < 0) {
+                renumber[target] = 0;
+                stack[top++] = target;
+            }
+        }
+    }
+
+    /* Number the survivors in their original order */
+    for (i = 0; i < self->kernel_count; i++) {
+        if (! (renumber[i] < 0)) {
+            renumber[i] = count++;
+        }
+    }
+
+    merge_kernels(self, renumber);
+    free(renumber);
+    free(stack);
+    return 0;
+}
+
+/* Skips the reductions of unit productions whose reduction is one of
+ * the named pass-through functions */
+int
+grammar_bypass_units(grammar_t self, char **reductions, int count)
+{
+    char *bypass;
+    int *units;
+    int i, j;
+
+    bypass = (char *)calloc(self->production_count, sizeof(char));
+    units = (int *)malloc(self->kernel_count * sizeof(int));
+    if (bypass == NULL || units == NULL) {
+        free(bypass);
+        free(units);
+        return -1;
+    }
+
+    /* Mark the unit productions with a pass-through reduction, leaving
+     * the start productions alone so that we still accept */
+    for (i = 1; i < self->production_count; i++) {
+        production_t production = self->productions[i];
+
+        if (production_get_count(production) != 1 ||
+            is_start_production(self, i)) {
+            continue;
+        }
+
+        for (j = 0; j < count; j++) {
+            if (strcmp(production_get_reduction(production),
+                       reductions[j]) == 0) {
+                bypass[i] = 1;
+            }
+        }
+    }
+
+    /* Find the kernels which do nothing but reduce by one of them */
+    for (i = 0; i < self->kernel_count; i++) {
+        units[i] = unit_kernel_production(self, self->kernels[i], bypass);
+    }
+
+    /* Send each shift and goto past them */
+    for (i = 0; i < self->kernel_count; i++) {
+        kernel_t kernel = self->kernels[i];
+
+        for (j = 0; j < self->nonterminal_count; j++) {
+            if (! (kernel->goto_table[j] < 0)) {
+                kernel->goto_table[j] = bypass_target(
+                    self, kernel, units, kernel->goto_table[j]);
+            }
+        }
+
+        for (j = 0; j < self->terminal_count; j++) {
+            if (action_is_shift(self, kernel->actions[j])) {
+                int target = bypass_target(
+                    self, kernel, units,
+                    action_shift_target(self, kernel->actions[j]));
+
+                kernel->actions[j] = shift_action(self, target);
+                kernel->goto_table[self->nonterminal_count + j] = target;
+            }
+        }
+    }
+
+    free(bypass);
+    free(units);
+
+    /* The skipped kernels are now unreachable */
+    return remove_unreachable_kernels(self);
+}
+
+/* Forward declaration */
+static unsigned long hash_set(const unsigned char *set, int size);
+
+/* Merges the kernels which act alike on every terminal and go to
+ * kernels which act alike on every nonterminal, splitting the kernels
+ * into ever finer blocks until no block splits.  Returns -1 if
+ * there's no memory, otherwise 0. */
+int
+grammar_minimize(grammar_t self)
+{
+    int width = 1 + self->terminal_count + self->nonterminal_count;
+    int kernel_count = self->kernel_count;
+    int bucket_count = 1;
+    int *buckets;
+    int *blocks;
+    int *next;
+    int *rows;
+    int previous = 0;
+    int count = 1;
+    int i, j;
+
+    while (bucket_count < 2 * self->kernel_count) {
+        bucket_count <<= 1;
+    }
+
+    buckets = (int *)malloc(bucket_count * sizeof(int));
+    blocks = (int *)calloc(self->kernel_count, sizeof(int));
+    next = (int *)malloc(self->kernel_count * sizeof(int));
+    rows = (int *)malloc(self->kernel_count * width * sizeof(int));
+    if (buckets == NULL || blocks == NULL || next == NULL || rows == NULL) {
+        free(buckets);
+        free(blocks);
+        free(next);
+        free(rows);
+        return -1;
+    }
+
+    /* Every kernel starts out in block 0 */
+    while (count != previous) {
+        int *swap;
+
+        previous = count;
+        count = 0;
+        memset(buckets, -1, bucket_count * sizeof(int));
+
+        for (i = 0; i < self->kernel_count; i++) {
+            kernel_t kernel = self->kernels[i];
+            int *row = rows + i * width;
+            unsigned long bucket;
+
+            /* Describe the kernel by its block, its actions with
+             * shifts to blocks and its gotos to blocks */
+            row[0] = blocks[i];
+            for (j = 0; j < self->terminal_count; j++) {
+                int action = kernel->actions[j];
+
+                row[1 + j] = action_is_shift(self, action) ?
+                    shift_action(
+                        self, blocks[action_shift_target(self, action)]) :
+                    action;
+            }
+
+            for (j = 0; j < self->nonterminal_count; j++) {
+                int target = kernel->goto_table[j];
+
+                row[1 + self->terminal_count + j] =
+                    target < 0 ? -1 : blocks[target];
+            }
+
+            /* Kernels which describe themselves alike share a block */
+            bucket = hash_set((unsigned char *)row, width * sizeof(int)) &
+                (bucket_count - 1);
+            while (buckets[bucket] != -1 &&
+                   memcmp(rows + buckets[bucket] * width, row,
+                          width * sizeof(int)) != 0) {
+                bucket = (bucket + 1) & (bucket_count - 1);
+            }
+
+            if (buckets[bucket] == -1) {
+                buckets[bucket] = i;
+                next[i] = count++;
+            } else {
+                next[i] = next[buckets[bucket]];
+            }
+        }
+
+        swap = blocks;
+        blocks = next;
+        next = swap;
+    }
+
+    /* The blocks are numbered in order of their first kernels, so the
+     * initial kernel keeps its number */
+    if (count != self->kernel_count) {
+        merge_kernels(self, blocks);
+    }
+
+    free(buckets);
+    free(blocks);
+    free(next);
+    free(rows);
+
+    sink_printf(self->log,
+                "Merged %d equivalent states: %d states (was %d)\n",
+                kernel_count - self->kernel_count, self->kernel_count,
+                kernel_count);
+    sink_flush(self->log);
+    return 0;
+}
+
+/* Forward declaration */
+static char *builtin_kind(grammar_t self, int index);
+
+/* Returns the number of productions by which some kernel reduces */
+static int
+count_reductions(grammar_t self)
+{
+    char *reduced;
+    int count = 0;
+    int i, j;
+
+    if ((reduced = (char *)calloc(self->production_count,
+                                  sizeof(char))) == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < self->kernel_count; i++) {
+        for (j = 0; j < self->terminal_count; j++) {
+            int action = self->kernels[i]->actions[j];
+
+            if (action_is_reduce(self, action) && ! reduced[action]) {
+                reduced[action] = 1;
+                count++;
+            }
+        }
+    }
+
+    free(reduced);
+    return count;
+}
+
+/* Answers the nonterminal's only production if it is small enough to
+ * be inlined, otherwise NULL.  It must consist of no more than size
+ * terminals, none of which has a precedence that could settle a
+ * conflict differently in its users. */
+static production_t
+inline_candidate(grammar_t self, int nonterminal, int size)
+{
+    production_t *productions = self->productions_by_nonterminal[nonterminal];
+    associativity_t associativity;
+    int count, i;
+
+    if (productions[0] == NULL || productions[1] != NULL ||
+        builtin_kind(self, production_get_index(productions[0])) != NULL) {
+        return NULL;
+    }
+
+    count = production_get_count(productions[0]);
+    if (count == 0 || size < count) {
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        component_t component = production_get_component(productions[0], i);
+
+        if (component_is_nonterminal(component) ||
+            component_get_precedence(component, &associativity) != 0) {
+            return NULL;
+        }
+    }
+
+    return productions[0];
+}
+
+/* Builds a copy of the production with the candidates spliced into
+ * it and records how to fold their reductions.  Returns 0 if there's
+ * nothing to inline, -1 if something goes wrong. */
+static int
+inline_production(grammar_t self, int index, production_t *candidates,
+                  production_t *result_out, struct folding **folding_out)
+{
+    production_t parent = self->productions[index];
+    int count = production_get_count(parent);
+    component_t *components;
+    struct folding *folding;
+    int length = 0;
+    int found = 0;
+    int i, j;
+
+    /* Leave the productions which libtpc reduces by itself alone */
+    if (builtin_kind(self, index) != NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        component_t component = production_get_component(parent, i);
+
+        if (component_is_nonterminal(component) &&
+            candidates[component_get_index(component)] != NULL) {
+            length += production_get_count(
+                candidates[component_get_index(component)]);
+            found = 1;
+        } else {
+            length++;
+        }
+    }
+
+    if (! found) {
+        return 0;
+    }
+
+    /* Splice in the candidates' right-hand sides */
+    folding = (struct folding *)malloc(sizeof(struct folding));
+    components = (component_t *)malloc(length * sizeof(component_t));
+    if (folding == NULL || components == NULL) {
+        free(folding);
+        free(components);
+        return -1;
+    }
+
+    folding->children = (production_t *)calloc(count, sizeof(production_t));
+    folding->reduction = (char *)malloc(32);
+    if (folding->children == NULL || folding->reduction == NULL) {
+        free(folding->children);
+        free(folding->reduction);
+        free(folding);
+        free(components);
+        return -1;
+    }
+
+    length = 0;
+    for (i = 0; i < count; i++) {
+        component_t component = production_get_component(parent, i);
+        production_t child = component_is_nonterminal(component) ?
+            candidates[component_get_index(component)] : NULL;
+
+        if (child == NULL) {
+            components[length++] = component;
+            continue;
+        }
+
+        folding->children[i] = child;
+        for (j = 0; j < production_get_count(child); j++) {
+            components[length++] = production_get_component(child, j);
+        }
+    }
+
+    sprintf(folding->reduction, "tpc_inline_%d", index);
+    if ((*result_out = production_alloc(
+             index,
+             self->nonterminals[production_get_nonterminal_index(parent)],
+             length, components, folding->reduction)) == NULL) {
+        free(folding->children);
+        free(folding->reduction);
+        free(folding);
+        free(components);
+        return -1;
+    }
+
+    folding->parent = parent;
+
+    /* Keep the precedence the production had as written */
+    if (production_get_precedence(parent) != NULL) {
+        production_set_precedence(*result_out,
+                                  production_get_precedence(parent));
+    }
+
+    *folding_out = folding;
+    return 1;
+}
+
+/* Releases the productions and foldings which grammar_inline built,
+ * leaving the original productions alone */
+static void
+discard_foldings(grammar_t self, production_t *productions,
+                 struct folding **foldings)
+{
+    int i;
+
+    for (i = 0; i < self->production_count; i++) {
+        if (foldings[i] != NULL) {
+            production_free(productions[i]);
+            free(foldings[i]->children);
+            free(foldings[i]->reduction);
+            free(foldings[i]);
+        }
+    }
+
+    free(productions);
+    free(foldings);
+}
+
+/* Inlines each nonterminal with a single production of no more than
+ * size terminals which is used by no more than uses productions,
+ * keeping the result only if it has no conflicts and no more states */
+int
+grammar_inline(grammar_t self, int size, int uses)
+{
+    struct grammar saved;
+    production_t *candidates;
+    production_t *productions;
+    struct folding **foldings;
+    int *start_kernels;
+    int *counts;
+    int *seen;
+    int inlined = 0;
+    int folded = 0;
+    int kernel_count;
+    int reductions;
+    int result;
+    int i, j;
+
+    /* The productions have already been rewritten */
+    if (self->foldings != NULL) {
+        return 0;
+    }
+
+    /* Don't try to tell new conflicts from old ones */
+    if (self->conflict_count != 0) {
+        sink_puts(self->log,
+                  "*** Warning: not inlining a grammar with conflicts\n");
+        sink_flush(self->log);
+        return 0;
+    }
+
+    candidates = (production_t *)calloc(self->nonterminal_count,
+                                        sizeof(production_t));
+    counts = (int *)calloc(self->nonterminal_count, sizeof(int));
+    seen = (int *)malloc(self->nonterminal_count * sizeof(int));
+    productions = (production_t *)malloc(
+        self->production_count * sizeof(production_t));
+    foldings = (struct folding **)calloc(self->production_count,
+                                         sizeof(struct folding *));
+    start_kernels = (int *)malloc(self->start_count * sizeof(int));
+    if (candidates == NULL || counts == NULL || seen == NULL ||
+        productions == NULL || foldings == NULL || start_kernels == NULL ||
+        (reductions = count_reductions(self)) < 0) {
+        free(candidates);
+        free(counts);
+        free(seen);
+        free(productions);
+        free(foldings);
+        free(start_kernels);
+        return -1;
+    }
+
+    /* Count the productions which use each nonterminal */
+    for (i = 0; i < self->nonterminal_count; i++) {
+        seen[i] = -1;
+    }
+
+    for (i = 0; i < self->production_count; i++) {
+        production_t production = self->productions[i];
+
+        for (j = 0; j < production_get_count(production); j++) {
+            component_t component = production_get_component(production, j);
+
+            if (component_is_nonterminal(component) &&
+                seen[component_get_index(component)] != i) {
+                seen[component_get_index(component)] = i;
+                counts[component_get_index(component)]++;
+            }
+        }
+    }
+
+    free(seen);
+
+    /* Pick the candidates, leaving the start symbol alone */
+    for (i = 0; i < self->nonterminal_count; i++) {
+        if (i != production_get_nonterminal_index(self->productions[0]) &&
+            counts[i] != 0 && counts[i] <= uses) {
+            candidates[i] = inline_candidate(self, i, size);
         }
     }
 
-    /* Print out the goto table's terminals */
-    for (i = 0; i < self->terminal_count; i++) {
-        if (! (kernel->goto_table[i + self->nonterminal_count] < 0)) {
-            fprintf(out, "    ");
-            component_print(self->terminals[i], out);
-            fprintf(out, ": %d\n",
-                    kernel->goto_table[i + self->nonterminal_count]);
-        }
+    /* Rewrite the productions which use them */
+    for (i = 0; i < self->production_count; i++) {
+        productions[i] = self->productions[i];
+        switch (inline_production(self, i, candidates,
+                                  &productions[i], &foldings[i])) {
+        case -1:
+            discard_foldings(self, productions, foldings);
+            free(candidates);
+            free(counts);
+            free(start_kernels);
+            return -1;
+
+        case 1:
+            folded++;
+            break;
+        }
+    }
+
+    /* Count the candidates which were actually inlined somewhere */
+    memset(counts, 0, self->nonterminal_count * sizeof(int));
+    for (i = 0; i < self->production_count; i++) {
+        for (j = 0; foldings[i] != NULL &&
+                 j < production_get_count(foldings[i]->parent); j++) {
+            production_t child = foldings[i]->children[j];
+
+            if (child != NULL &&
+                counts[production_get_nonterminal_index(child)]++ == 0) {
+                inlined++;
+            }
+        }
+    }
+
+    free(candidates);
+    free(counts);
+
+    if (folded == 0) {
+        free(productions);
+        free(foldings);
+        free(start_kernels);
+        return 0;
+    }
+
+    /* Build the new automaton quietly in case we can't keep it.  The
+     * inlined nonterminals keep their productions, which just become
+     * unreachable. */
+    saved = *self;
+    kernel_count = self->kernel_count;
+    memcpy(start_kernels, self->start_kernels,
+           self->start_count * sizeof(int));
+    self->productions = productions;
+    self->foldings = foldings;
+    self->productions_by_nonterminal = NULL;
+    self->generates = NULL;
+    self->nullable = NULL;
+    self->kernel_count = 0;
+    self->kernels = NULL;
+    self->conflict_count = 0;
+    self->log = NULL;
+
+    result = compute_automaton(self);
+    if (result < 0 || self->conflict_count != 0 ||
+        kernel_count < self->kernel_count) {
+        /* Put everything back the way it was */
+        i = self->conflict_count;
+        j = self->kernel_count;
+        discard_automaton(self);
+        discard_foldings(self, productions, foldings);
+        *self = saved;
+        memcpy(self->start_kernels, start_kernels,
+               self->start_count * sizeof(int));
+        free(start_kernels);
+        if (result < 0) {
+            return -1;
+        }
+
+        if (i != 0) {
+            sink_printf(self->log,
+                        "*** Warning: inlining would add %d conflicts; "
+                        "leaving the grammar as written\n", i);
+        } else {
+            sink_printf(self->log,
+                        "*** Warning: inlining would need %d states "
+                        "(was %d); leaving the grammar as written\n",
+                        j, kernel_count);
+        }
+
+        sink_flush(self->log);
+        return 0;
+    }
+
+    /* Release the old automaton */
+    free(start_kernels);
+    self->log = saved.log;
+    discard_automaton(&saved);
+    free(saved.productions);
+
+    sink_printf(self->log,
+                "Inlined %d nonterminals into %d productions: "
+                "%d states (was %d), %d reductions (was %d)\n",
+                inlined, folded, self->kernel_count, kernel_count,
+                count_reductions(self), reductions);
+    sink_flush(self->log);
+    return 0;
+}
+
+
+/* Prints a single kernel */
+void
+print_kernel(grammar_t self, int index, sink_t out)
+{
+    kernel_t kernel = self->kernels[index];
+    char *follows;
+    int i;
+
+    sink_printf(out, "Kernel %d\n", index);
+    for (i = 0; i < kernel->count; i++) {
+        int first = 1;
+        int pi;
+        int j;
+
+        int offset = decode(self, kernel->pairs[i], &pi);
+        sink_printf(out, " %d: ", i);
+        production_print_with_offset(self->productions[pi], out, offset);
+
+        for (j = 0; j < self->terminal_count; j++) {
+            if (kernel->follows_table[i][j]) {
+                if (first) {
+                    sink_puts(out, ", ");
+                    first = 0;
+                } else {
+                    sink_puts(out, "/ ");
+                }
+
+                component_print(self->terminals[j], out);
+            }
+        }
+
+        sink_puts(out, "\n");
+    }
+
+    /* And the empty productions which are reduced in the kernel */
+    if ((follows = (char *)malloc(self->terminal_count)) != NULL) {
+        for (i = 0; i < self->production_count; i++) {
+            int first = 1;
+            int j;
+
+            if (production_get_count(self->productions[i]) != 0 ||
+                ! compute_empty_follows(self, kernel, i, follows)) {
+                continue;
+            }
+
+            sink_puts(out, " -: ");
+            production_print_with_offset(self->productions[i], out, 0);
+            for (j = 0; j < self->terminal_count; j++) {
+                if (follows[j]) {
+                    sink_puts(out, first ? ", " : "/ ");
+                    first = 0;
+                    component_print(self->terminals[j], out);
+                }
+            }
+
+            sink_puts(out, "\n");
+        }
+
+        free(follows);
+    }
+
+    /* Print out the goto table's nonterminals */
+    for (i = 0; i < self->nonterminal_count; i++) {
+        if (! (kernel->goto_table[i] < 0)) {
+            sink_puts(out, "    ");
+            component_print(self->nonterminals[i], out);
+            sink_printf(out, ": %d\n", kernel->goto_table[i]);
+        }
+    }
+
+    /* Print out the goto table's terminals */
+    for (i = 0; i < self->terminal_count; i++) {
+        if (! (kernel->goto_table[i + self->nonterminal_count] < 0)) {
+            sink_puts(out, "    ");
+            component_print(self->terminals[i], out);
+            sink_printf(out, ": %d\n",
+                        kernel->goto_table[i + self->nonterminal_count]);
+        }
+    }
+
+    sink_puts(out, "\n");
+}
+
+/* Print out the kernels */
+void
+grammar_print_kernels(grammar_t self, sink_t out)
+{
+    int index;
+
+    for (index = 0; index < self->kernel_count; index++) {
+        print_kernel(self, index, out);
+    }
+}
+
+
+/* Print out some macros that simplify table access */
+static void
+print_c_header(grammar_t self, encoding_t encoding, sink_t out)
+{
+    sink_printf(out,
+                "/* Generated by %s version %s */\n\n"
+                "#include <stdint.h>\n\n",
+                PACKAGE, VERSION);
+
+    /* Tagged actions keep their kind in the low bits */
+    if (encoding == ENCODING_TAGGED) {
+        sink_puts(out,
+                  "#define ACTION_ERROR 0\n"
+                  "#define ACTION_SHIFT 1\n"
+                  "#define ACTION_REDUCE 2\n"
+                  "#define ACTION_ACCEPT 3\n"
+                  "#define ACTION_KIND(action) ((action) & 3)\n"
+                  "#define IS_ERROR(action) ((action) == ACTION_ERROR)\n"
+                  "#define IS_ACCEPT(action) ((action) == ACTION_ACCEPT)\n"
+                  "#define IS_REDUCE(action) "
+                  "(ACTION_KIND(action) == ACTION_REDUCE)\n"
+                  "#define IS_SHIFT(action) "
+                  "(ACTION_KIND(action) == ACTION_SHIFT)\n"
+                  "#define REDUCTION(action) ((action) >> 2)\n"
+                  "#define REDUCE_GOTO(state, production) \\\n"
+                  "    (goto_table[state][production->nonterm_type])\n"
+                  "#define SHIFT_GOTO(action) ((action) >> 2)\n\n");
+        return;
+    }
+
+    sink_printf(out,
+                "#define IS_ERROR(action) ((action) == 0)\n"
+                "#define IS_ACCEPT(action) ((action) == %d)\n"
+                "#define IS_REDUCE(action) (0 < (action) && (action) < %d)\n"
+                "#define IS_SHIFT(action) (%d <= (action) && (action) < %d)\n"
+                "#define REDUCTION(action) (action)\n"
+                "#define REDUCE_GOTO(state, production) \\\n"
+                "    (goto_table[state][production->nonterm_type])\n"
+                "#define SHIFT_GOTO(action) ((action) - %d)\n\n",
+                self->production_count + self->kernel_count,
+                self->production_count,
+                self->production_count,
+                self->production_count + self->kernel_count,
+                self->production_count);
+}
+
+/* Returns the narrowest unsigned C type which can hold values up to max */
+static char *
+c_integer_type(unsigned long max)
+{
+    if (max <= 0xff) {
+        return "uint8_t";
+    }
+
+    if (max <= 0xffff) {
+        return "uint16_t";
+    }
+
+    return "uint32_t";
+}
+
+/* Returns the largest value which will appear in the shift/reduce table */
+static unsigned long
+max_action(grammar_t self, encoding_t encoding)
+{
+    unsigned long max;
+    int i;
+
+    /* Range-encoded actions simply count upwards to ACC, and past it
+     * to accept at the other entry points */
+    if (encoding != ENCODING_TAGGED) {
+        max = 0;
+        for (i = 0; i < self->start_count; i++) {
+            if (max < (unsigned long)self->starts[i]) {
+                max = self->starts[i];
+            }
+        }
+
+        return self->production_count + self->kernel_count + max;
+    }
+
+    /* Tagged actions shift the larger of a state or production
+     * number up past the tag bits */
+    max = self->production_count > self->kernel_count ?
+        self->production_count : self->kernel_count;
+    return ((max - 1) << 2) | 3;
+}
+
+/* Returns the largest value which will appear in the goto table */
+static unsigned long
+max_state(grammar_t self)
+{
+    return self->kernel_count - 1;
+}
+
+/* Prints an enumeration which lists the various terminals */
+static void
+print_c_terminal_enum(grammar_t self, sink_t out)
+{
+    int index;
+
+    /* Print the enum header */
+    sink_puts(out, "typedef enum\n{\n");
+
+    /* Print each terminal */
+    for (index = 0; index < self->terminal_count; index++) {
+        component_print_c_enum(self->terminals[index], out);
+    }
+
+    sink_puts(out, "\n} terminal_t;\n\n");
+}
+
+/* Prints an enumeration which names the entry points, if there's
+ * more than the first production */
+static void
+print_c_start_enum(grammar_t self, sink_t out)
+{
+    int index;
+    char *name;
+
+    if (self->start_count < 2) {
+        return;
+    }
+
+    sink_puts(out, "typedef enum\n{\n");
+
+    /* Name each after the nonterminal it parses */
+    for (index = 0; index < self->start_count; index++) {
+        production_t production = self->productions[self->starts[index]];
+
+        name = component_get_name(index == 0 ?
+            self->nonterminals[production_get_nonterminal_index(production)] :
+            production_get_component(production, 0));
+        sink_puts(out, index == 0 ? "    TS_" : ",\n    TS_");
+        for (; *name != '\0'; name++) {
+            sink_putc(out, isalnum((unsigned char)*name) ? *name : '_');
+        }
+
+        if (index == 0) {
+            sink_puts(out, " = 0");
+        }
+    }
+
+    sink_puts(out, "\n} start_t;\n\n");
+}
+
+/* Prints the definition of the productions table's structure */
+static void
+print_c_production_struct(grammar_t self, sink_t out)
+{
+    sink_puts(out,
+              "struct production\n{\n"
+              "    reduction_t reduction;\n"
+              "    int nonterm_type;\n"
+              "    int count;\n};\n\n");
+}
+
+/* Prints out the reduction table */
+static void
+print_c_reduction_table(grammar_t self, char *type, sink_t out)
+{
+    int index;
+
+    /* Print the table header */
+    sink_printf(out, "static const struct %s productions[%d] =\n{\n",
+	    type, self->production_count);
+
+    /* Print the production functions */
+    for (index = 0; index < self->production_count; index++) {
+        production_t production = self->productions[index];
+
+        /* Put some space between the entries */
+        if (index != 0) {
+            sink_puts(out, ",\n\n");
+        }
+
+        /* Print out a comment containing the production */
+        sink_printf(out, "    /* %d: ", index);
+        production_print(production, out);
+        sink_puts(out, "*/\n");
+
+        /* Print the production's struct */
+        production_print_c_struct(production, out);
+    }
+
+    /* Print the table footer */
+    sink_puts(out, "\n};\n\n");
+}
+
+/* Prints out the contribution of a kernel to the SR table */
+static void
+print_kernel_SR_entry(grammar_t self,
+                      int kernel_index,
+                      char *lparen,
+                      char *rparen,
+                      char *separator,
+                      sink_t out)
+{
+    kernel_t kernel = self->kernels[kernel_index];
+    int index;
+
+    /* Print out the table entry */
+    sink_puts(out, "    ");
+    sink_puts(out, lparen);
+
+    /* Print the action for each terminal */
+    for (index = 0; index < self->terminal_count; index++) {
+        int action = kernel->actions[index];
+
+        /* Print a comma separator */
+        if (index != 0) {
+            sink_puts(out, separator);
+        }
+
+        if (action_is_shift(self, action)) {
+            sink_puts(out, "S(");
+            sink_int(out, action_shift_target(self, action));
+            sink_putc(out, ')');
+        } else if (action_is_reduce(self, action)) {
+            sink_puts(out, "R(");
+            sink_int(out, action);
+            sink_putc(out, ')');
+        } else if (action == ACC_ACTION) {
+            sink_puts(out, "ACC");
+        } else if (action_is_accept(self, action)) {
+            sink_puts(out, "A(");
+            sink_int(out, action);
+            sink_putc(out, ')');
+        } else {
+            sink_puts(out, "ERR");
+        }
+    }
+
+    /* Close this table entry */
+    sink_puts(out, rparen);
+}
+
+/* Prints out the shift/reduce table */
+static void
+print_c_shift_reduce_table(grammar_t self, encoding_t encoding, sink_t out)
+{
+    int index;
+
+    /* Print the type of the table's entries */
+    sink_printf(out, "typedef %s tpc_action_t;\n\n",
+                c_integer_type(max_action(self, encoding)));
+
+    /* Print out some helpful macros */
+    if (encoding == ENCODING_TAGGED) {
+        sink_puts(out,
+                  "#define ERR 0\n"
+                  "#define ACC 3\n"
+                  "#define R(x) (((x) << 2) | 2)\n"
+                  "#define S(x) (((x) << 2) | 1)\n\n");
+    } else {
+        sink_printf(out,
+                    "#define ERR 0\n"
+                    "#define ACC %d\n"
+                    "#define R(x) (x)\n"
+                    "#define S(x) (x + %d)\n\n",
+                    self->production_count + self->kernel_count,
+                    self->production_count);
+    }
+
+    /* Accepting at another entry point also names its production */
+    if (1 < self->start_count) {
+        sink_puts(out, encoding == ENCODING_TAGGED ?
+                  "#define A(x) (((x) << 2) | 3)\n\n" :
+                  "#define A(x) (ACC + (x))\n\n");
+    }
+
+    /* Print the SR table header */
+    sink_printf(out, "static const tpc_action_t sr_table[%d][%d] =\n{\n",
+	    self->kernel_count,
+	    self->terminal_count);
+
+    /* Go through each kernel and print out its part of the SR table */
+    for (index = 0; index < self->kernel_count; index++) {
+	if (index != 0) {
+	    sink_puts(out, ",\n");
+	}
+
+	print_kernel_SR_entry(self, index, "{ ", " }", ", ", out);
+    }
+
+    /* Close off the SR table and undefine our macros */
+    sink_puts(out,
+              "\n};\n\n"
+              "#undef ERR\n"
+              "#undef R\n"
+              "#undef S\n");
+    if (1 < self->start_count) {
+        sink_puts(out, "#undef A\n");
+    }
+
+    sink_puts(out, "\n");
+}
+
+/* Prints out the goto table in C format */
+static void
+print_c_goto_table(grammar_t self, sink_t out)
+{
+    int index;
+
+    /* Print the type of the table's entries */
+    sink_printf(out, "typedef %s tpc_state_t;\n\n",
+                c_integer_type(max_state(self)));
+
+    /* Print the goto table header */
+    sink_printf(out, "static const tpc_state_t goto_table[%d][%d] =\n{\n",
+	    self->kernel_count,
+	    self->nonterminal_count);
+
+    /* Go through each kernel and print its portion of the goto table */
+    for (index = 0; index < self->kernel_count; index++) {
+        kernel_t kernel = self->kernels[index];
+        int i;
+
+        if (index != 0) {
+            sink_puts(out, ",\n");
+        }
+
+        sink_puts(out, "    { ");
+
+        /* Go through each nonterminal and look up its goto information */
+        for (i = 0; i < self->nonterminal_count; i++) {
+            int ki = kernel->goto_table[i];
+            if (i != 0) {
+                sink_puts(out, ", ");
+            }
+
+            sink_int(out, (ki < 0) ? 0 : ki);
+        }
+
+        sink_puts(out, " }");
+    }
+
+    /* Close off the goto table */
+    sink_puts(out, "\n};\n\n");
+}
+
+/* Print out the parse tables in C format */
+void
+grammar_print_c_tables(grammar_t self, encoding_t encoding, sink_t out)
+{
+    print_c_header(self, encoding, out);
+    print_c_terminal_enum(self, out);
+    print_c_production_struct(self, out);
+    print_c_reduction_table(self, "production", out);
+    print_c_shift_reduce_table(self, encoding, out);
+    print_c_goto_table(self, out);
+}
+
+/* Prints an array of the names of some symbols */
+static void
+print_c_names(char *name, component_t *symbols, int count, sink_t out)
+{
+    int index;
+
+    sink_printf(out, "static const char *const %s[%d] =\n{\n", name, count);
+    for (index = 0; index < count; index++) {
+        sink_printf(out, "%s    \"%s\"", index == 0 ? "" : ",\n",
+                    component_get_name(symbols[index]));
+    }
+
+    sink_puts(out, "\n};\n\n");
+}
+
+/* Answers non-zero if the productions share a reduction function */
+static int
+same_reduction(grammar_t self, int i, int j)
+{
+    return strcmp(production_get_reduction(self->productions[i]),
+                  production_get_reduction(self->productions[j])) == 0;
+}
+
+/* Answers the name of the reduction which the production's values
+ * end up with: that of the production as written if nonterminals were
+ * inlined into it */
+static char *
+called_reduction(grammar_t self, int index)
+{
+    if (self->foldings != NULL && self->foldings[index] != NULL) {
+        return production_get_reduction(self->foldings[index]->parent);
+    }
+
+    return production_get_reduction(self->productions[index]);
+}
+
+/* Prints the functions which perform the reductions of the inlined
+ * nonterminals before calling that of the production they went into */
+static void
+print_c_foldings(grammar_t self, sink_t out)
+{
+    int i, j, offset;
+
+    for (i = 0; self->foldings != NULL && i < self->production_count; i++) {
+        struct folding *folding = self->foldings[i];
+        int count;
+
+        if (folding == NULL) {
+            continue;
+        }
+
+        count = production_get_count(folding->parent);
+        sink_puts(out, "/* ");
+        production_print(folding->parent, out);
+        sink_printf(out,
+                    "*/\n"
+                    "static int\n"
+                    "%s(void *rock, tpc_frame_t *args, void **result_out)\n"
+                    "{\n"
+                    "    tpc_frame_t frames[%d];\n\n",
+                    folding->reduction, count);
+
+        /* Line the values up as the production was written */
+        offset = 0;
+        for (j = 0; j < count; j++) {
+            sink_printf(out, "    frames[%d] = args[%d];\n", j, offset);
+            offset += folding->children[j] == NULL ?
+                1 : production_get_count(folding->children[j]);
+        }
+
+        /* Reduce the inlined components in place */
+        offset = 0;
+        for (j = 0; j < count; j++) {
+            production_t child = folding->children[j];
+
+            if (child == NULL) {
+                offset++;
+                continue;
+            }
+
+            sink_printf(out,
+                        "\n    if (%s(rock, args + %d, "
+                        "&frames[%d].value) < 0) {\n"
+                        "        return -1;\n"
+                        "    }\n",
+                        production_get_reduction(child), offset, j);
+            offset += production_get_count(child);
+        }
+
+        sink_printf(out, "\n    return %s(rock, frames, result_out);\n}\n\n",
+                    production_get_reduction(folding->parent));
+    }
+}
+
+/* Answers the kind of production which libtpc performs itself for
+ * the production's reduction, or NULL if it calls the reduction */
+static char *
+builtin_kind(grammar_t self, int index)
+{
+    static char *builtins[][2] =
+    {
+        { "tpc_list_empty", "TPC_LIST_EMPTY" },
+        { "tpc_list_one", "TPC_LIST_ONE" },
+        { "tpc_list_append", "TPC_LIST_APPEND" },
+        { "tpc_option_none", "TPC_OPTION_NONE" },
+        { "tpc_option_some", "TPC_OPTION_SOME" },
+        { "tpc_pass", "TPC_PASS" }
+    };
+    char *reduction = production_get_reduction(self->productions[index]);
+    size_t i;
+
+    for (i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        if (strcmp(reduction, builtins[i][0]) == 0) {
+            return builtins[i][1];
+        }
+    }
+
+    return NULL;
+}
+
+/* Answers nonzero if libtpc performs any of the productions itself */
+int
+grammar_has_builtins(grammar_t self)
+{
+    int index;
+
+    for (index = 0; index < self->production_count; index++) {
+        if (builtin_kind(self, index) != NULL) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Prints the kind of each production if any is one of libtpc's own.
+ * Answers nonzero if the table was printed. */
+static int
+print_c_kinds_table(grammar_t self, sink_t out)
+{
+    int index;
+
+    if (! grammar_has_builtins(self)) {
+        return 0;
+    }
+
+    sink_printf(out, "static const unsigned char kinds[%d] =\n{\n",
+                self->production_count);
+    for (index = 0; index < self->production_count; index++) {
+        char *kind = builtin_kind(self, index);
+
+        sink_puts(out, index == 0 ? "    " : ",\n    ");
+        sink_puts(out, kind == NULL ? "TPC_REDUCE" : kind);
+    }
+
+    sink_puts(out, "\n};\n\n");
+    return 1;
+}
+
+/* Answers the hash of a set of size bytes */
+static unsigned long
+hash_set(const unsigned char *set, int size)
+{
+    unsigned long hash = 2166136261UL;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        hash = ((hash ^ set[i]) * 16777619UL) & 0xffffffffUL;
+    }
+
+    return hash;
+}
+
+/* Prints a bitset of the terminals for which each state has an
+ * action.  States with the same set share a single copy of it.
+ * Returns 0 on success, -1 if there's no memory. */
+static int
+print_c_expected_tables(grammar_t self, sink_t out)
+{
+    int size = (self->terminal_count + 7) / 8;
+    unsigned char *sets;
+    int *buckets;
+    int *index;
+    int bucket_count = 1;
+    int count = 0;
+    int i, j;
+
+    while (bucket_count < 2 * self->kernel_count) {
+        bucket_count <<= 1;
+    }
+
+    sets = (unsigned char *)calloc(self->kernel_count, size);
+    buckets = (int *)malloc(bucket_count * sizeof(int));
+    index = (int *)malloc(self->kernel_count * sizeof(int));
+    if (sets == NULL || buckets == NULL || index == NULL) {
+        free(sets);
+        free(buckets);
+        free(index);
+        return -1;
+    }
+
+    memset(buckets, -1, bucket_count * sizeof(int));
+
+    /* Work out each kernel's set, keeping only the distinct ones */
+    for (i = 0; i < self->kernel_count; i++) {
+        unsigned char *set = sets + count * size;
+        unsigned long bucket;
+
+        for (j = 0; j < self->terminal_count; j++) {
+            if (self->kernels[i]->actions[j] != ERR_ACTION) {
+                set[j >> 3] |= 1 << (j & 7);
+            }
+        }
+
+        /* Look for an earlier copy of the set */
+        bucket = hash_set(set, size) & (bucket_count - 1);
+        while (buckets[bucket] != -1 &&
+               memcmp(sets + buckets[bucket] * size, set, size) != 0) {
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+
+        if (buckets[bucket] == -1) {
+            buckets[bucket] = count++;
+        } else {
+            memset(set, 0, size);
+        }
+
+        index[i] = buckets[bucket];
+    }
+
+    /* Print the distinct sets, one per line */
+    sink_printf(out,
+                "/* The terminals with an action in each state, as %d-byte\n"
+                " * bitsets with terminal t at bit (t & 7) of byte (t >> 3) */\n"
+                "static const unsigned char expected_sets[%d] =\n{\n",
+                size, count * size);
+    for (i = 0; i < count; i++) {
+        sink_puts(out, i == 0 ? "    " : ",\n    ");
+        for (j = 0; j < size; j++) {
+            sink_printf(out, j == 0 ? "0x%02x" : ", 0x%02x",
+                        sets[i * size + j]);
+        }
+    }
+
+    /* And the set of each state */
+    sink_printf(out,
+                "\n};\n\n"
+                "typedef %s tpc_expected_t;\n\n"
+                "static const tpc_expected_t expected_index[%d] =\n{\n",
+                c_integer_type(count - 1), self->kernel_count);
+    for (i = 0; i < self->kernel_count; i++) {
+        sink_puts(out, i == 0 ? "    " : ", ");
+        sink_int(out, index[i]);
+    }
+
+    sink_puts(out, "\n};\n\n");
+
+    free(sets);
+    free(buckets);
+    free(index);
+    return 0;
+}
+
+/* Prints the initial state of each entry point after the first.
+ * Answers nonzero if the table was printed. */
+static int
+print_c_start_table(grammar_t self, sink_t out)
+{
+    int index;
+
+    if (self->start_count < 2) {
+        return 0;
+    }
+
+    sink_printf(out, "static const int start_states[%d] =\n{\n",
+                self->start_count);
+    for (index = 0; index < self->start_count; index++) {
+        sink_puts(out, index == 0 ? "    " : ", ");
+        sink_int(out, self->start_kernels[index]);
+    }
+
+    sink_puts(out, "\n};\n\n");
+    return 1;
+}
+
+/* Prints the descriptor of the runtime tables.  If dispatch is
+ * nonzero then it refers to tpc_dispatch() and the symbol tables in
+ * place of a productions table, if kinds is nonzero then to the kinds
+ * table and if starts is nonzero then to the start states table. */
+static void
+print_c_descriptor(grammar_t self, encoding_t encoding, char *header,
+                   int dispatch, int kinds, int starts, sink_t out)
+{
+    sink_printf(out,
+                "%sconst tpc_tables_t tpc_tables =\n{\n"
+                "    %s,\n"
+                "    sizeof(tpc_action_t),\n"
+                "    sizeof(tpc_state_t),\n"
+                "    %d, %d, %d, %d,\n"
+                "    %s,\n"
+                "    sr_table,\n"
+                "    goto_table,\n"
+                "    terminal_names,\n"
+                "    nonterminal_names,\n",
+                header == NULL ? "static " : "",
+                encoding == ENCODING_TAGGED ?
+                "TPC_ENCODING_TAGGED" : "TPC_ENCODING_RANGE",
+                self->terminal_count,
+                self->nonterminal_count,
+                self->production_count,
+                self->kernel_count,
+                dispatch ? "NULL" : "productions");
+
+    if (dispatch) {
+        sink_puts(out,
+                  "    tpc_dispatch,\n"
+                  "    sizeof(tpc_symbol_t),\n"
+                  "    nonterm_types,\n"
+                  "    counts,\n");
+    } else {
+        sink_puts(out,
+                  "    NULL,\n"
+                  "    0,\n"
+                  "    NULL,\n"
+                  "    NULL,\n");
+    }
+
+    sink_printf(out,
+                "    sizeof(tpc_expected_t),\n"
+                "    %d,\n"
+                "    expected_index,\n"
+                "    expected_sets,\n"
+                "    %s,\n"
+                "    %d,\n"
+                "    %s\n"
+                "};\n",
+                (self->terminal_count + 7) / 8,
+                kinds ? "kinds" : "NULL",
+                starts ? self->start_count : 0,
+                starts ? "start_states" : "NULL");
+}
+
+/* Prints the includes of the runtime tables.  If they have a header
+ * then it declares the terminals, otherwise they come here */
+static void
+print_c_runtime_preamble(grammar_t self, char *header, sink_t out)
+{
+    sink_printf(out,
+                "/* Generated by %s version %s */\n\n"
+                "#include <stdint.h>\n",
+                PACKAGE, VERSION);
+
+    if (header != NULL) {
+        sink_printf(out, "#include \"%s\"\n\n", header);
+        return;
+    }
+
+    sink_puts(out, "#include \"tpc_runtime.h\"\n\n");
+    print_c_terminal_enum(self, out);
+    print_c_start_enum(self, out);
+}
+
+/* Prints a header which declares the terminals, the reductions and
+ * the tables written with the same header name */
+void
+grammar_print_c_runtime_header(grammar_t self, char *header, sink_t out)
+{
+    char *guard;
+    int i, j;
+
+    /* Make an include guard out of the header's name */
+    if ((guard = strdup(header)) == NULL) {
+        return;
+    }
+
+    for (i = 0; guard[i] != '\0'; i++) {
+        guard[i] = isalnum((unsigned char)guard[i]) ?
+            toupper((unsigned char)guard[i]) : '_';
+    }
+
+    sink_printf(out,
+                "/* Generated by %s version %s */\n\n"
+                "#ifndef %s\n"
+                "#define %s\n\n"
+                "#include \"tpc_runtime.h\"\n\n",
+                PACKAGE, VERSION, guard, guard);
+
+    print_c_terminal_enum(self, out);
+    print_c_start_enum(self, out);
+
+    /* Declare each reduction once, leaving libtpc's own to it and
+     * the functions which fold inlined reductions to the tables */
+    sink_puts(out, "/* The reduction functions */\n");
+    for (i = 0; i < self->production_count; i++) {
+        if (builtin_kind(self, i) != NULL) {
+            continue;
+        }
+
+        for (j = 0; j < i; j++) {
+            if (strcmp(called_reduction(self, i),
+                       called_reduction(self, j)) == 0) {
+                break;
+            }
+        }
+
+        if (j == i) {
+            sink_printf(out,
+                        "int %s(void *rock, tpc_frame_t *args, "
+                        "void **result_out);\n",
+                        called_reduction(self, i));
+        }
+    }
+
+    sink_printf(out,
+                "\n/* The parse tables */\n"
+                "extern const tpc_tables_t tpc_tables;\n\n"
+                "#endif /* %s */\n",
+                guard);
+    free(guard);
+}
+
+/* Print out the parse tables for use with the tpc runtime */
+int
+grammar_print_c_runtime_tables(grammar_t self, encoding_t encoding,
+                               char *header, sink_t out)
+{
+    int kinds;
+    int starts;
+
+    print_c_runtime_preamble(self, header, out);
+    print_c_foldings(self, out);
+    print_c_reduction_table(self, "tpc_production", out);
+    print_c_shift_reduce_table(self, encoding, out);
+    print_c_goto_table(self, out);
+    print_c_names("terminal_names", self->terminals,
+                  self->terminal_count, out);
+    print_c_names("nonterminal_names", self->nonterminals,
+                  self->nonterminal_count, out);
+    if (print_c_expected_tables(self, out) < 0) {
+        return -1;
+    }
+
+    kinds = print_c_kinds_table(self, out);
+    starts = print_c_start_table(self, out);
+    print_c_descriptor(self, encoding, header, 0, kinds, starts, out);
+    return 0;
+}
+
+/* Prints the left-hand side and length of each production in two
+ * narrow arrays */
+static void
+print_c_symbol_tables(grammar_t self, sink_t out)
+{
+    unsigned long max = self->nonterminal_count - 1;
+    int index;
+
+    /* Both arrays share the narrowest type which fits either */
+    for (index = 0; index < self->production_count; index++) {
+        int count = production_get_count(self->productions[index]);
+
+        if ((unsigned long)count > max) {
+            max = count;
+        }
+    }
+
+    sink_printf(out, "typedef %s tpc_symbol_t;\n\n", c_integer_type(max));
+
+    sink_printf(out, "static const tpc_symbol_t nonterm_types[%d] =\n{\n",
+                self->production_count);
+    for (index = 0; index < self->production_count; index++) {
+        sink_puts(out, index == 0 ? "    " : ", ");
+        sink_int(out,
+                 production_get_nonterminal_index(self->productions[index]));
+    }
+
+    sink_printf(out, "\n};\n\nstatic const tpc_symbol_t counts[%d] =\n{\n",
+                self->production_count);
+    for (index = 0; index < self->production_count; index++) {
+        sink_puts(out, index == 0 ? "    " : ", ");
+        sink_int(out, production_get_count(self->productions[index]));
+    }
+
+    sink_puts(out, "\n};\n\n");
+}
+
+/* Prints a function which calls the reduction of the numbered
+ * production, sharing a case among productions with the same one */
+static void
+print_c_dispatch(grammar_t self, sink_t out)
+{
+    int i, j;
+
+    sink_puts(out,
+              "/* Calls the reduction of the numbered production */\n"
+              "static int\n"
+              "tpc_dispatch(void *rock, int production, tpc_frame_t *args,\n"
+              "             void **result_out)\n"
+              "{\n"
+              "    switch (production) {\n");
+
+    for (i = 0; i < self->production_count; i++) {
+        /* libtpc performs its own kinds of production without a case */
+        if (builtin_kind(self, i) != NULL) {
+            continue;
+        }
+
+        /* Skip reductions which already have their case */
+        for (j = 0; j < i; j++) {
+            if (same_reduction(self, i, j)) {
+                break;
+            }
+        }
+
+        if (j < i) {
+            continue;
+        }
+
+        /* Gather up every production with the same reduction */
+        for (j = i; j < self->production_count; j++) {
+            if (same_reduction(self, i, j)) {
+                sink_printf(out, "    case %d:\n", j);
+            }
+        }
+
+        sink_printf(out, "        return %s(rock, args, result_out);\n\n",
+                    production_get_reduction(self->productions[i]));
+    }
+
+    sink_puts(out,
+              "    default:\n"
+              "        return -1;\n"
+              "    }\n"
+              "}\n\n");
+}
+
+/* Print out the parse tables for use with the tpc runtime, with a
+ * switch which calls the reductions in place of a productions table */
+int
+grammar_print_c_switch_tables(grammar_t self, encoding_t encoding,
+                              char *header, sink_t out)
+{
+    int kinds;
+    int starts;
+
+    print_c_runtime_preamble(self, header, out);
+    print_c_symbol_tables(self, out);
+    print_c_foldings(self, out);
+    print_c_dispatch(self, out);
+    print_c_shift_reduce_table(self, encoding, out);
+    print_c_goto_table(self, out);
+    print_c_names("terminal_names", self->terminals,
+                  self->terminal_count, out);
+    print_c_names("nonterminal_names", self->nonterminals,
+                  self->nonterminal_count, out);
+    if (print_c_expected_tables(self, out) < 0) {
+        return -1;
+    }
+
+    kinds = print_c_kinds_table(self, out);
+    starts = print_c_start_table(self, out);
+    print_c_descriptor(self, encoding, header, 1, kinds, starts, out);
+    return 0;
+}
+
+
+
+/* Prints the preamble of a direct-coded parser */
+static void
+print_c_code_header(grammar_t self, sink_t out)
+{
+    sink_printf(out,
+                "/* Generated by %s version %s */\n\n"
+                "/* The including file must define parser_t, the push(), pop()\n"
+                " * and top() functions which manage its state and value stacks\n"
+                " * and each of the reduction functions named below. */\n\n"
+                "#ifndef TPC_OK\n"
+                "#define TPC_OK 0\n"
+                "#define TPC_ACCEPT 1\n"
+                "#define TPC_ERR_SYNTAX -1\n"
+                "#define TPC_ERR_REDUCE -2\n"
+                "#define TPC_ERR_NOMEM -3\n"
+                "#endif\n\n",
+                PACKAGE, VERSION);
+}
+
+/* Marks the productions which are reduced by some kernel */
+static char *
+compute_used_reductions(grammar_t self)
+{
+    char *used;
+    int i, j;
+
+    if ((used = (char *)calloc(self->production_count, sizeof(char))) == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < self->kernel_count; i++) {
+        for (j = 0; j < self->terminal_count; j++) {
+            int action = self->kernels[i]->actions[j];
+
+            if (action_is_reduce(self, action)) {
+                used[action] = 1;
+            }
+        }
+    }
+
+    return used;
+}
+
+/* Prints a function which answers the state to enter after reducing
+ * to the given nonterminal */
+static void
+print_c_code_goto(grammar_t self, int nonterminal, sink_t out)
+{
+    int *counts;
+    int common = 0;
+    int targets = 0;
+    int i, j;
+
+    /* Count how often each state is the target */
+    counts = (int *)calloc(self->kernel_count, sizeof(int));
+    for (i = 0; i < self->kernel_count; i++) {
+        int ki = self->kernels[i]->goto_table[nonterminal];
+
+        if (ki < 0) {
+            continue;
+        }
+
+        if (counts[ki]++ == 0) {
+            targets++;
+        }
+
+        if (counts[ki] > counts[common]) {
+            common = ki;
+        }
+    }
+
+    sink_puts(out, "/* Returns the state to enter after reducing to ");
+    component_print(self->nonterminals[nonterminal], out);
+    sink_printf(out, "*/\nstatic int\ngoto_%d(int state)\n{\n", nonterminal);
+
+    /* Don't bother with a switch if there's only one target */
+    if (targets < 2) {
+        sink_printf(out, "    return %d;\n}\n\n", common);
+        free(counts);
+        return;
+    }
+
+    sink_puts(out, "    switch (state) {\n");
+
+    /* Print the less common targets, grouping states by target */
+    for (i = 0; i < self->kernel_count; i++) {
+        if (i == common || counts[i] == 0) {
+            continue;
+        }
+
+        for (j = 0; j < self->kernel_count; j++) {
+            if (self->kernels[j]->goto_table[nonterminal] == i) {
+                sink_printf(out, "    case %d:\n", j);
+            }
+        }
+
+        sink_printf(out, "        return %d;\n\n", i);
+    }
+
+    /* And use the most common one as the default */
+    sink_printf(out,
+                "    default:\n"
+                "        return %d;\n"
+                "    }\n"
+                "}\n\n",
+                common);
+    free(counts);
+}
+
+/* Prints the switch which chooses a kernel's action for each terminal */
+static void
+print_c_code_kernel(grammar_t self, int kernel_index, sink_t out)
+{
+    kernel_t kernel = self->kernels[kernel_index];
+    char *done;
+    int i, j;
+
+    done = (char *)calloc(self->terminal_count, sizeof(char));
+
+    sink_printf(out, "        case %d:\n            switch (type) {\n",
+                kernel_index);
+
+    /* Group the terminals which share an action */
+    for (i = 0; i < self->terminal_count; i++) {
+        int action = kernel->actions[i];
+
+        if (done[i] || action == ERR_ACTION) {
+            continue;
+        }
+
+        for (j = i; j < self->terminal_count; j++) {
+            if (kernel->actions[j] == action) {
+                sink_printf(out, "            case TT_%s:\n",
+                            j == 0 ? "EOF" :
+                            component_get_name(self->terminals[j]));
+                done[j] = 1;
+            }
+        }
+
+        if (action_is_shift(self, action)) {
+            sink_printf(out,
+                        "                if (push(self, %d, value) < 0) {\n"
+                        "                    return TPC_ERR_NOMEM;\n"
+                        "                }\n\n"
+                        "                return TPC_OK;\n\n",
+                        action_shift_target(self, action));
+        } else if (action == ACC_ACTION) {
+            sink_puts(out, "                goto accept;\n\n");
+        } else {
+            sink_printf(out, "                goto reduce_%d;\n\n", action);
+        }
+    }
+
+    sink_puts(out,
+              "            default:\n"
+              "                return TPC_ERR_SYNTAX;\n"
+              "            }\n\n");
+    free(done);
+}
+
+/* Prints the code which performs a reduction */
+static void
+print_c_code_reduction(grammar_t self, int production_index, sink_t out)
+{
+    production_t production = self->productions[production_index];
+
+    sink_printf(out, "    reduce_%d:\n        /* ", production_index);
+    production_print(production, out);
+    sink_printf(out,
+                "*/\n"
+                "        pop(self, %d);\n"
+                "        if ((result = %s(self)) == NULL) {\n"
+                "            return TPC_ERR_REDUCE;\n"
+                "        }\n\n"
+                "        if (push(self, goto_%d(top(self)), result) < 0) {\n"
+                "            return TPC_ERR_NOMEM;\n"
+                "        }\n\n"
+                "        continue;\n\n",
+                production_get_count(production),
+                production_get_reduction(production),
+                production_get_nonterminal_index(production));
+}
+
+/* Prints the function which drives the parser */
+static void
+print_c_code_shift_reduce(grammar_t self, char *used, sink_t out)
+{
+    production_t start = self->productions[0];
+    int index;
+
+    sink_puts(out,
+              "/* Performs all possible reductions and then shifts in the\n"
+              " * terminal.  Returns TPC_OK after a shift, TPC_ACCEPT with the\n"
+              " * result in *result_out after accepting, or a TPC_ERR code */\n"
+              "static int\n"
+              "tpc_shift_reduce(parser_t self, terminal_t type, void *value,\n"
+              "                 void **result_out)\n"
+              "{\n"
+              "    void *result;\n\n"
+              "    while (1) {\n"
+              "        switch (top(self)) {\n");
+
+    /* Print the actions of each kernel */
+    for (index = 0; index < self->kernel_count; index++) {
+        print_c_code_kernel(self, index, out);
+    }
+
+    sink_puts(out,
+              "        default:\n"
+              "            return TPC_ERR_SYNTAX;\n"
+              "        }\n\n");
+
+    /* Print the reductions */
+    for (index = 1; index < self->production_count; index++) {
+        if (used[index]) {
+            print_c_code_reduction(self, index, out);
+        }
+    }
+
+    /* Accepting reduces the first production without a goto */
+    sink_puts(out, "    accept:\n        /* ");
+    production_print(start, out);
+    sink_printf(out,
+                "*/\n"
+                "        pop(self, %d);\n"
+                "        if ((*result_out = %s(self)) == NULL) {\n"
+                "            return TPC_ERR_REDUCE;\n"
+                "        }\n\n"
+                "        return TPC_ACCEPT;\n"
+                "    }\n"
+                "}\n",
+                production_get_count(start),
+                production_get_reduction(start));
+}
+
+/* Print out a direct-coded parser in C format */
+void
+grammar_print_c_code(grammar_t self, sink_t out)
+{
+    char *used;
+    char *reduced;
+    int index;
+
+    /* Work out which reductions and gotos are needed */
+    if ((used = compute_used_reductions(self)) == NULL) {
+        return;
+    }
+
+    reduced = (char *)calloc(self->nonterminal_count, sizeof(char));
+    for (index = 1; index < self->production_count; index++) {
+        if (used[index]) {
+            reduced[production_get_nonterminal_index(
+                self->productions[index])] = 1;
+        }
+    }
+
+    print_c_code_header(self, out);
+    print_c_terminal_enum(self, out);
+
+    /* Print a goto function for each nonterminal we reduce to */
+    for (index = 0; index < self->nonterminal_count; index++) {
+        if (reduced[index]) {
+            print_c_code_goto(self, index, out);
+        }
+    }
+
+    print_c_code_shift_reduce(self, used, out);
+
+    free(reduced);
+    free(used);
+}
+
+
+/* Returns the numeric value of an action in the given encoding */
+static unsigned long
+encode_action(grammar_t self, encoding_t encoding, int action)
+{
+    if (action_is_shift(self, action)) {
+        int target = action_shift_target(self, action);
+
+        return encoding == ENCODING_TAGGED ?
+            ((unsigned long)target << 2) | 1 :
+            (unsigned long)(target + self->production_count);
+    }
+
+    if (action_is_reduce(self, action)) {
+        return encoding == ENCODING_TAGGED ?
+            ((unsigned long)action << 2) | 2 :
+            (unsigned long)action;
+    }
+
+    if (action == ACC_ACTION) {
+        return encoding == ENCODING_TAGGED ?
+            3 : (unsigned long)(self->production_count + self->kernel_count);
     }
 
-    fprintf(out, "\n");
+    return 0;
 }
 
-/* Print out the kernels */
-void
-grammar_print_kernels(grammar_t self, FILE *out)
+/* Returns the number of bytes in an entry which can hold values up to max */
+static int
+integer_size(unsigned long max)
 {
-    int index;
-
-    for (index = 0; index < self->kernel_count; index++) {
-        print_kernel(self, index, out);
+    if (max <= 0xff) {
+        return 1;
     }
-}
 
+    if (max <= 0xffff) {
+        return 2;
+    }
 
-/* Print out some macros that simplify table access */
-static void
-print_c_header(grammar_t self, FILE *out)
-{
-    fprintf(out,
-            "/* Generated by %s version %s */\n\n"
-            "#define IS_ERROR(action) ((action) == 0)\n"
-            "#define IS_ACCEPT(action) ((action) == %d)\n"
-            "#define IS_REDUCE(action) (0 < (action) && (action) < %d)\n"
-            "#define IS_SHIFT(action) (%d <= (action) && (action) < %d)\n"
-            "#define REDUCTION(action) (action)\n"
-            "#define REDUCE_GOTO(state, production) \\\n"
-            "    (goto_table[state][production->nonterm_type])\n"
-            "#define SHIFT_GOTO(action) ((action) - %d)\n\n",
-            PACKAGE, VERSION,
-            self->production_count + self->kernel_count,
-            self->production_count,
-            self->production_count,
-            self->production_count + self->kernel_count,
-            self->production_count);
+    return 4;
 }
 
-/* Prints an enumeration which lists the various terminals */
+/* Stores an integer of the given size at an index into a table */
 static void
-print_c_terminal_enum(grammar_t self, FILE *out)
+write_entry(unsigned char *table, int size, size_t index, unsigned long value)
 {
-    int index;
-
-    /* Print the enum header */
-    fprintf(out, "typedef enum\n{\n");
-
-    /* Print each terminal */
-    for (index = 0; index < self->terminal_count; index++) {
-        component_print_c_enum(self->terminals[index], out);
+    switch (size) {
+    case 1:
+        ((uint8_t *)table)[index] = (uint8_t)value;
+        break;
+
+    case 2:
+        ((uint16_t *)table)[index] = (uint16_t)value;
+        break;
+
+    default:
+        ((uint32_t *)table)[index] = (uint32_t)value;
+        break;
     }
+}
 
-    fprintf(out, "\n} terminal_t;\n\n");
+/* Rounds an offset up to the alignment of a binary table section */
+static size_t
+binary_align(size_t offset)
+{
+    return (offset + TPC_BINARY_ALIGN - 1) & ~(size_t)(TPC_BINARY_ALIGN - 1);
 }
 
-/* Prints out the reduction table */
-static void
-print_c_reduction_table(grammar_t self, FILE *out)
+/* Print out the parse tables as a binary table file which can be
+ * loaded with tpc_tables_load().  Returns 0 on success, -1 on failure */
+int
+grammar_print_binary_tables(grammar_t self, encoding_t encoding, sink_t out)
 {
-    int index;
+    tpc_binary_header_t header;
+    unsigned char *image;
+    uint32_t *names;
+    char *strings;
+    size_t strings_length = 0;
+    size_t offset;
+    int symbol_count = self->terminal_count + self->nonterminal_count;
+    int result;
+    int i, j;
 
-    /* Define the structure type */
-    fprintf(out,
-            "struct production\n{\n"
-            "    reduction_t reduction;\n"
-            "    int nonterm_type;\n"
-            "    int count;\n};\n\n");
+    /* Measure the strings */
+    for (i = 0; i < self->terminal_count; i++) {
+        strings_length += strlen(component_get_name(self->terminals[i])) + 1;
+    }
 
-    /* Print the table header */
-    fprintf(out, "static struct production productions[%d] =\n{\n",
-	    self->production_count);
+    for (i = 0; i < self->nonterminal_count; i++) {
+        strings_length += strlen(component_get_name(self->nonterminals[i])) + 1;
+    }
 
-    /* Print the production functions */
-    for (index = 0; index < self->production_count; index++) {
-        production_t production = self->productions[index];
+    for (i = 0; i < self->production_count; i++) {
+        strings_length +=
+            strlen(production_get_reduction(self->productions[i])) + 1;
+    }
 
-        /* Put some space between the entries */
-        if (index != 0) {
-            fprintf(out, ",\n\n");
-        }
+    /* Lay out the sections */
+    memset(&header, 0, sizeof(header));
+    header.magic = TPC_BINARY_MAGIC;
+    header.version = TPC_BINARY_VERSION;
+    header.encoding = encoding == ENCODING_TAGGED ?
+        TPC_ENCODING_TAGGED : TPC_ENCODING_RANGE;
+    header.action_size = integer_size(max_action(self, encoding));
+    header.state_size = integer_size(max_state(self));
+    header.terminal_count = self->terminal_count;
+    header.nonterminal_count = self->nonterminal_count;
+    header.production_count = self->production_count;
+    header.kernel_count = self->kernel_count;
+
+    offset = binary_align(sizeof(header));
+    header.productions_offset = offset;
+    offset = binary_align(offset + self->production_count * 8);
+    header.sr_table_offset = offset;
+    offset = binary_align(offset + (size_t)self->kernel_count *
+                          self->terminal_count * header.action_size);
+    header.goto_table_offset = offset;
+    offset = binary_align(offset + (size_t)self->kernel_count *
+                          self->nonterminal_count * header.state_size);
+    header.names_offset = offset;
+    offset = binary_align(offset +
+                          (symbol_count + self->production_count) * 4);
+    header.strings_offset = offset;
+    header.size = offset + strings_length;
+
+    /* Build the image in memory */
+    if ((image = (unsigned char *)calloc(header.size, 1)) == NULL) {
+        return -1;
+    }
 
-        /* Print out a comment containing the production */
-        fprintf(out, "    /* %d: ", index);
-        production_print(production, out);
-        fprintf(out, "*/\n");
+    for (i = 0; i < self->production_count; i++) {
+        uint32_t *pair = (uint32_t *)(image + header.productions_offset) + i * 2;
 
-        /* Print the production's struct */
-        production_print_c_struct(production, out);
+        pair[0] = production_get_nonterminal_index(self->productions[i]);
+        pair[1] = production_get_count(self->productions[i]);
     }
 
-    /* Print the table footer */
-    fprintf(out, "\n};\n\n");
-}
+    for (i = 0; i < self->kernel_count; i++) {
+        kernel_t kernel = self->kernels[i];
 
-/* Returns the index of the first production in the kernel to be
- * listed in the input file */
-static int
-first_production_index(grammar_t self, kernel_t kernel)
-{
-    int index;
-    int result = self->production_count;
+        for (j = 0; j < self->terminal_count; j++) {
+            write_entry(image + header.sr_table_offset, header.action_size,
+                        (size_t)i * self->terminal_count + j,
+                        encode_action(self, encoding, kernel->actions[j]));
+        }
 
-    /* Go through the pairs and find the first listed production */
-    for (index = 0; index < kernel->count; index++) {
-        int test;
+        for (j = 0; j < self->nonterminal_count; j++) {
+            int ki = kernel->goto_table[j];
 
-        decode(self, kernel->pairs[index], &test);
-        if (test < result) {
-            result = test;
+            write_entry(image + header.goto_table_offset, header.state_size,
+                        (size_t)i * self->nonterminal_count + j,
+                        ki < 0 ? 0 : ki);
+        }
+    }
+
+    /* Copy the names into the strings section */
+    names = (uint32_t *)(image + header.names_offset);
+    strings = (char *)(image + header.strings_offset);
+    offset = 0;
+    for (i = 0; i < symbol_count + self->production_count; i++) {
+        char *name;
+
+        if (i < self->terminal_count) {
+            name = component_get_name(self->terminals[i]);
+        } else if (i < symbol_count) {
+            name = component_get_name(
+                self->nonterminals[i - self->terminal_count]);
+        } else {
+            name = production_get_reduction(
+                self->productions[i - symbol_count]);
         }
+
+        names[i] = offset;
+        strcpy(strings + offset, name);
+        offset += strlen(name) + 1;
     }
 
+    /* Checksum everything after the header and write it all out */
+    header.checksum = tpc_adler32(image + sizeof(header),
+                                  header.size - sizeof(header));
+    memcpy(image, &header, sizeof(header));
+    sink_write(out, image, header.size);
+    result = sink_flush(out);
+
+    free(image);
     return result;
 }
 
-/* Prints out the contribution of a kernel to the SR table */
+
+/* Prints the preamble of the C++ header */
 static void
-print_kernel_SR_entry(grammar_t self,
-                      int kernel_index,
-                      char *lparen,
-                      char *rparen,
-                      char *separator,
-                      FILE *out)
+print_cxx_header(grammar_t self, char *name, sink_t out)
 {
-    kernel_t kernel = self->kernels[kernel_index];
-    int *reductions;
-    int index;
-
-    /* Create a table in which to record the reductions */
-    reductions = (int *)malloc(self->terminal_count * sizeof(int));
-    memset(reductions, -1, self->terminal_count * sizeof(int));
+    sink_printf(out,
+                "// Generated by %s version %s\n\n"
+                "#pragma once\n\n"
+                "#include <array>\n"
+                "#include <cstddef>\n"
+                "#include <cstdint>\n"
+                "#include <utility>\n"
+                "#include <vector>\n\n"
+                "namespace %s\n{\n\n",
+                PACKAGE, VERSION, name);
+}
 
-    /* Populate the reductions table */
-    for (index = 0; index < kernel->count; index++) {
-        int pi;
-        int offset = decode(self, kernel->pairs[index], &pi);
-        production_t production = self->productions[pi];
+/* Prints the terminals as an enum class.  The scope takes the place
+ * of the C enum's prefix, and EOF is a macro, so the end of the input
+ * is spelled eof. */
+static void
+print_cxx_terminal_enum(grammar_t self, sink_t out)
+{
+    int index;
 
-        /* We reduce on the follow set if we're the end of the production */
-        if (production_get_component(production, offset) == NULL) {
-            int i;
-
-            /* Traverse the follows set */
-            for (i = 0; i < self->terminal_count; i++) {
-                if (kernel->follows_table[index][i]) {
-                    /* Report reduce/reduce conflicts */
-                    if (reductions[i] != -1) {
-                        fprintf(stderr,
-                                "*** Warning: reduce/reduce conflict on ");
-                        component_print(self->terminals[i], stderr);
-                        fprintf(stderr, "in kernel %d\n", kernel_index);
-                        fprintf(stderr, "  [using first listed reduction]\n");
-                        print_kernel(self, kernel_index, stderr);
-                    } else {
-                        reductions[i] = pi;
-                    }
-                }
-            }
-        }
+    sink_printf(out, "enum class terminal : std::%s\n{\n    eof = 0",
+                c_integer_type(self->terminal_count - 1));
+    for (index = 1; index < self->terminal_count; index++) {
+        sink_printf(out, ",\n    %s",
+                    component_get_name(self->terminals[index]));
     }
 
-    /* Print out the table entry */
-    fprintf(out, "    %s", lparen);
+    sink_puts(out, "\n};\n\n");
+}
 
-    /* Print the terminal transitions */
-    for (index = 0; index < self->terminal_count; index++) {
-        int ki = kernel->goto_table[self->nonterminal_count + index];
-        int shift = (ki < 0) ? 0 : ki;
-        int reduction = reductions[index];
+/* Prints the constexpr tables */
+static void
+print_cxx_tables(grammar_t self, sink_t out)
+{
+    int i, j;
 
-        /* Print a comma separator */
-        if (index != 0) {
-            fprintf(out, "%s", separator);
-        }
+    sink_printf(out,
+                "using action_t = std::%s;\n"
+                "using state_t = std::%s;\n\n"
+                "inline constexpr std::size_t terminal_count = %d;\n"
+                "inline constexpr std::size_t nonterminal_count = %d;\n"
+                "inline constexpr std::size_t production_count = %d;\n"
+                "inline constexpr std::size_t kernel_count = %d;\n\n",
+                c_integer_type(max_action(self, ENCODING_TAGGED)),
+                c_integer_type(max_state(self)),
+                self->terminal_count,
+                self->nonterminal_count,
+                self->production_count,
+                self->kernel_count);
+
+    /* Print the shift/reduce table with tagged actions */
+    sink_printf(out,
+                "// The shift/reduce table, indexed by state * terminal_count +\n"
+                "// terminal.  The low two bits of an action are 0 for an error,\n"
+                "// 1 for a shift, 2 for a reduction or 3 to accept, and the rest\n"
+                "// are the target state or production.\n"
+                "inline constexpr std::array<action_t, %d> sr_table =\n{\n",
+                self->kernel_count * self->terminal_count);
+    for (i = 0; i < self->kernel_count; i++) {
+        sink_puts(out, i == 0 ? "    " : ",\n    ");
+        for (j = 0; j < self->terminal_count; j++) {
+            if (j != 0) {
+                sink_puts(out, ", ");
+            }
 
-        /* See if there's a shift action for this terminal */
-        if (shift != 0) {
-            /* Report shift/reduce conflicts */
-            if (reduction != -1) {
-                int si;
+            sink_int(out, (long)encode_action(self, ENCODING_TAGGED,
+                                              self->kernels[i]->actions[j]));
+        }
+    }
 
-                fprintf(stderr, "*** Warning: shift/reduce conflict on ");
-                component_print(self->terminals[index], stderr);
-                fprintf(stderr, "in kernel %d\n", kernel_index);
+    sink_puts(out, "\n};\n\n");
 
-                /* Resolve the conflict according to the order of the
-                 * productions in the grammar.  Figure out which
-                 * production generated the shift operation */
-                si = first_production_index(self, self->kernels[shift]);
-                if (reduction < si) {
-                    fprintf(out, "R(%d)", reduction);
-                    fprintf(stderr, "    [choosing to reduce]\n");
-                } else {
-                    fprintf(out, "S(%d)", shift);
-                    fprintf(stderr, "    [choosing to shift]\n");
-                }
+    /* Print the goto table */
+    sink_printf(out,
+                "// The goto table, indexed by state * nonterminal_count +\n"
+                "// nonterminal\n"
+                "inline constexpr std::array<state_t, %d> goto_table =\n{\n",
+                self->kernel_count * self->nonterminal_count);
+    for (i = 0; i < self->kernel_count; i++) {
+        sink_puts(out, i == 0 ? "    " : ",\n    ");
+        for (j = 0; j < self->nonterminal_count; j++) {
+            int ki = self->kernels[i]->goto_table[j];
 
-                /* Print the kernel for reference */
-                print_kernel(self, kernel_index, stderr);
-            } else {
-                /* Print out a shift */
-                fprintf(out, "S(%d)", shift);
+            if (j != 0) {
+                sink_puts(out, ", ");
             }
-        } else if (reduction == 0) {
-            /* Accept */
-            fprintf(out, "ACC");
-        } else if (reduction > 0) {
-            /* Normal reduction */
-            fprintf(out, "R(%d)", reduction);
-        } else {
-            /* Error */
-            fprintf(out, "ERR");
+
+            sink_int(out, (ki < 0) ? 0 : ki);
         }
     }
 
-    /* Close this table entry */
-    fprintf(out, "%s", rparen);
-
-    /* Clean up */
-    free(reductions);
+    sink_puts(out, "\n};\n\n");
 }
 
-/* Prints out the shift/reduce table */
+/* Prints the case of the parser's switch which performs a reduction */
 static void
-print_c_shift_reduce_table(grammar_t self, FILE *out)
+print_cxx_reduction(grammar_t self, int index, sink_t out)
 {
-    int max = self->production_count + self->kernel_count;
-    int index;
+    production_t production = self->productions[index];
+    int count = production_get_count(production);
+    int i;
 
-    /* Print out some helpful macros */
-    fprintf(out,
-            "#define ERR 0\n"
-            "#define ACC %d\n"
-            "#define R(x) (x)\n"
-            "#define S(x) (x + %d)\n\n",
-            max, self->production_count);
+    sink_printf(out, "            case %d: {\n                // ", index);
+    production_print(production, out);
+    sink_puts(out, "\n");
 
-    /* Print the SR table header */
-    fprintf(out, "static unsigned int sr_table[%d][%d] =\n{\n",
-	    self->kernel_count,
-	    self->terminal_count);
+    /* Call the reduction with the values of the components */
+    if (count != 0) {
+        sink_printf(out,
+                    "                frame *args = &stack_.back() - %d;\n",
+                    count - 1);
+    }
 
-    /* Go through each kernel and print out its part of the SR table */
-    for (index = 0; index < self->kernel_count; index++) {
-	if (index != 0) {
-	    fprintf(out, ",\n");
-	}
+    sink_printf(out,
+                "                value_type value = actions_.reduce_%s(",
+                production_get_reduction(production));
+    for (i = 0; i < count; i++) {
+        sink_printf(out, "%sstd::move(args[%d].value)", i == 0 ? "" : ", ", i);
+    }
 
-	print_kernel_SR_entry(self, index, "{ ", " }", ", ", out);
+    sink_puts(out, ");\n");
+
+    /* Accept after reducing by the start production */
+    if (index == 0) {
+        sink_puts(out,
+                  "                result = std::move(value);\n"
+                  "                reset();\n"
+                  "                return status::accept;\n"
+                  "            }\n\n");
+        return;
     }
 
-    /* Close off the SR table and undefine our macros */
-    fprintf(out,
-            "\n};\n\n"
-            "#undef ERR\n"
-            "#undef R\n"
-            "#undef S\n\n");
+    /* Replace the components with the nonterminal */
+    if (count == 0) {
+        sink_printf(out,
+                    "                stack_.push_back(frame { goto_state(%d), "
+                    "std::move(value) });\n",
+                    production_get_nonterminal_index(production));
+    } else {
+        if (count > 1) {
+            sink_printf(out,
+                        "                stack_.erase(stack_.end() - %d, "
+                        "stack_.end());\n",
+                        count - 1);
+        }
+
+        sink_printf(out,
+                    "                frame &top = stack_.back();\n"
+                    "                top.state = goto_table[(&top)[-1].state * "
+                    "nonterminal_count + %d];\n"
+                    "                top.value = std::move(value);\n",
+                    production_get_nonterminal_index(production));
+    }
+
+    sink_puts(out,
+              "                break;\n"
+              "            }\n\n");
 }
 
-/* Prints out the goto table in C format */
+/* Prints the parser template */
 static void
-print_c_goto_table(grammar_t self, FILE *out)
+print_cxx_parser(grammar_t self, sink_t out)
 {
     int index;
 
-    /* Print the goto table header */
-    fprintf(out, "static unsigned int goto_table[%d][%d] =\n{\n",
-	    self->kernel_count,
-	    self->nonterminal_count);
-
-    /* Go through each kernel and print its portion of the goto table */
-    for (index = 0; index < self->kernel_count; index++) {
-        kernel_t kernel = self->kernels[index];
-        int i;
-
-        if (index != 0) {
-            fprintf(out, ",\n");
-        }
-
-        fprintf(out, "    { ");
-
-        /* Go through each nonterminal and look up its goto information */
-        for (i = 0; i < self->nonterminal_count; i++) {
-            int ki = kernel->goto_table[i];
-            if (i == 0) {
-                fprintf(out, "%d", (ki < 0) ? 0 : ki);
-            } else {
-                fprintf(out, ", %d", (ki < 0) ? 0 : ki);
-            }
-        }
+    sink_puts(out,
+              "// The results of feeding a token to a parser\n"
+              "enum class status { ok, accept, syntax_error };\n\n"
+              "// A parser which calls Actions::reduce_<name>() for each reduction\n"
+              "// with the values of its production's components.  The values\n"
+              "// are of type Actions::value_type, which must be default\n"
+              "// constructible and movable.\n"
+              "template <typename Actions>\n"
+              "class parser\n"
+              "{\n"
+              "public:\n"
+              "    using value_type = typename Actions::value_type;\n\n"
+              "    explicit parser(Actions &actions, std::size_t capacity = 32)\n"
+              "        : actions_(actions)\n"
+              "    {\n"
+              "        stack_.reserve(capacity);\n"
+              "        reset();\n"
+              "    }\n\n"
+              "    // Discards any partial parse.  This must be called if a\n"
+              "    // reduction throws.\n"
+              "    void reset()\n"
+              "    {\n"
+              "        stack_.clear();\n"
+              "        stack_.push_back(frame { 0, value_type() });\n"
+              "    }\n\n"
+              "    // Returns the parser's current state\n"
+              "    int state() const\n"
+              "    {\n"
+              "        return stack_.back().state;\n"
+              "    }\n\n"
+              "    // Feeds a token to the parser.  Sets result and returns\n"
+              "    // status::accept if it completed a parse.\n"
+              "    status feed(terminal type, value_type value, value_type &result)\n"
+              "    {\n"
+              "        const std::size_t t = static_cast<std::size_t>(type);\n\n"
+              "        for (;;) {\n"
+              "            const action_t action =\n"
+              "                sr_table[stack_.back().state * terminal_count + t];\n\n"
+              "            if ((action & 3) == 1) {\n"
+              "                stack_.push_back(frame {\n"
+              "                    static_cast<state_t>(action >> 2), std::move(value) });\n"
+              "                return status::ok;\n"
+              "            }\n\n"
+              "            if (action == 0) {\n"
+              "                return status::syntax_error;\n"
+              "            }\n\n"
+              "            // Accepting reduces by production 0\n"
+              "            switch (action >> 2) {\n");
 
-        fprintf(out, " }");
+    for (index = 0; index < self->production_count; index++) {
+        print_cxx_reduction(self, index, out);
     }
 
-    /* Close off the goto table */
-    fprintf(out, "\n};\n\n");
+    sink_puts(out,
+              "            default:\n"
+              "                return status::syntax_error;\n"
+              "            }\n"
+              "        }\n"
+              "    }\n\n"
+              "private:\n"
+              "    struct frame\n"
+              "    {\n"
+              "        state_t state;\n"
+              "        value_type value;\n"
+              "    };\n\n"
+              "    // Returns the state to enter after pushing a nonterminal\n"
+              "    state_t goto_state(std::size_t nonterminal) const\n"
+              "    {\n"
+              "        return goto_table[stack_.back().state * nonterminal_count +\n"
+              "                          nonterminal];\n"
+              "    }\n\n"
+              "    Actions &actions_;\n"
+              "    std::vector<frame> stack_;\n"
+              "};\n\n");
 }
 
-/* Print out the parse tables in C format */
+/* Print out the parse tables and a parser template in C++ format */
 void
-grammar_print_c_tables(grammar_t self, FILE *out)
+grammar_print_cxx(grammar_t self, char *name, sink_t out)
 {
-    print_c_header(self, out);
-    print_c_terminal_enum(self, out);
-    print_c_reduction_table(self, out);
-    print_c_shift_reduce_table(self, out);
-    print_c_goto_table(self, out);
+    print_cxx_header(self, name == NULL ? "tpc" : name, out);
+    print_cxx_terminal_enum(self, out);
+    print_cxx_tables(self, out);
+    print_cxx_parser(self, out);
+    sink_puts(out, "}\n");
 }
 
 
-
 /* Prints the python header */
 static void
-print_python_header(grammar_t self, char *module, FILE *out)
+print_python_header(grammar_t self, char *module, sink_t out)
 {
     /* Print a comment */
-    fprintf(out, "# Generated by %s version %s\n\n", PACKAGE, VERSION);
+    sink_printf(out, "# Generated by %s version %s\n\n", PACKAGE, VERSION);
 
     /* Print the import line if a module was specified */
     if (module != NULL) {
-        fprintf(out, "import %s\n\n", module);
+        sink_printf(out, "import %s\n\n", module);
     }
 }
 
 
 /* Prints the terminals in python format */
 static void
-print_python_terminals(grammar_t self, FILE *out)
+print_python_terminals(grammar_t self, sink_t out)
 {
     int index;
 
@@ -1380,17 +4411,17 @@ print_python_terminals(grammar_t self, FILE *out)
         component_print_python_assign(self->terminals[index], out);
     }
 
-    fprintf(out, "\n");
+    sink_puts(out, "\n");
 }
 
 /* Print out the reductions table in python format */
 static void
-print_python_reductions(grammar_t self, char *module, FILE *out)
+print_python_reductions(grammar_t self, char *module, sink_t out)
 {
     int index;
 
     /* Print the table header */
-    fprintf(out, "productions = (\n");
+    sink_puts(out, "productions = (\n");
 
     /* Print out the production rules */
     for (index = 0; index < self->production_count; index++) {
@@ -1398,59 +4429,59 @@ print_python_reductions(grammar_t self, char *module, FILE *out)
 
         /* Put some space between the entries */
         if (index != 0) {
-            fprintf(out, ",\n\n");
+            sink_puts(out, ",\n\n");
         }
 
         /* Print out a comment containing the production */
-        fprintf(out, "    # %d: ", index);
+        sink_printf(out, "    # %d: ", index);
         production_print(production, out);
-        fprintf(out, "\n");
+        sink_puts(out, "\n");
 
         /* Print the production's python tuple */
         production_print_python_tuple(production, module, out);
     }
 
-    fprintf(out, ")\n\n");
+    sink_puts(out, ")\n\n");
 }
 
 /* Prints out the shift-reduce table in python format */
 static void
-print_python_shift_reduce_table(grammar_t self, FILE *out)
+print_python_shift_reduce_table(grammar_t self, sink_t out)
 {
     int index;
 
     /* Print out some functions which help generate tables */
-    fprintf(out,
-            "ERR = -1\n"
-            "ACC = 0\n\n"
-            "def R(x):\n"
-            "    return x\n\n"
-            "def S(x):\n"
-            "    return x + %d\n\n",
-            self->production_count);
+    sink_printf(out,
+                "ERR = -1\n"
+                "ACC = 0\n\n"
+                "def R(x):\n"
+                "    return x\n\n"
+                "def S(x):\n"
+                "    return x + %d\n\n",
+                self->production_count);
 
-    fprintf(out, "sr_table = (\n");
+    sink_puts(out, "sr_table = (\n");
 
     /* Go through each kernel and print out its part of the SR table */
     for (index = 0; index < self->kernel_count; index++) {
         if (index != 0) {
-            fprintf(out, ",\n");
+            sink_puts(out, ",\n");
         }
 
         print_kernel_SR_entry(self, index, "(", ")", ", ", out);
     }
 
-    fprintf(out, ")\n\n");
+    sink_puts(out, ")\n\n");
 }
 
 /* Prints out the goto table in python format */
 static void
-print_python_goto_table(grammar_t self, FILE *out)
+print_python_goto_table(grammar_t self, sink_t out)
 {
     int index;
 
     /* Print the goto table */
-    fprintf(out, "goto_table = (\n");
+    sink_puts(out, "goto_table = (\n");
 
     /* Go through each kernel and print its portion of the goto table */
     for (index = 0; index < self->kernel_count; index++) {
@@ -1458,31 +4489,288 @@ print_python_goto_table(grammar_t self, FILE *out)
         int i;
 
         if (index != 0) {
-            fprintf(out, ",\n");
+            sink_puts(out, ",\n");
         }
 
-        fprintf(out, "    (");
+        sink_puts(out, "    (");
 
         /* Go through each nonterminal and look up its goto information */
         for (i = 0; i < self->nonterminal_count; i++) {
             int ki = kernel->goto_table[i];
-            if (i == 0) {
-                fprintf(out, "%d", (ki < 0) ? 0 : ki);
-            } else {
-                fprintf(out, ", %d", (ki < 0) ? 0 : ki);
+            if (i != 0) {
+                sink_puts(out, ", ");
             }
+
+            sink_int(out, (ki < 0) ? 0 : ki);
         }
 
-        fprintf(out, ")");
+        sink_puts(out, ")");
     }
 
     /* Close off the goto table */
-    fprintf(out, ")\n\n");
+    sink_puts(out, ")\n\n");
+}
+
+/* Returns the array typecode of the narrowest entries which can hold
+ * values from -1 (if is_signed) up to max, and its size in bytes */
+static char *
+python_array_type(unsigned long max, int is_signed, int *size_out)
+{
+    if (max <= (is_signed ? 0x7f : 0xff)) {
+        *size_out = 1;
+        return is_signed ? "b" : "B";
+    }
+
+    if (max <= (is_signed ? 0x7fff : 0xffff)) {
+        *size_out = 2;
+        return is_signed ? "h" : "H";
+    }
+
+    *size_out = 4;
+    return is_signed ? "i" : "I";
+}
+
+/* Prints a value as size little-endian bytes of a python bytes literal */
+static void
+print_python_bytes(long value, int size, sink_t out)
+{
+    unsigned long bits = (unsigned long)value;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        int ch = (int)((bits >> (i * 8)) & 0xff);
+
+        /* Print the character itself if it's printable and harmless */
+        if (0x20 <= ch && ch < 0x7f && ch != '\\' && ch != '\'') {
+            sink_putc(out, ch);
+        } else {
+            sink_puts(out, "\\x");
+            sink_putc(out, "0123456789abcdef"[ch >> 4]);
+            sink_putc(out, "0123456789abcdef"[ch & 0xf]);
+        }
+    }
+}
+
+/* Prints the helpers used by the compact python tables */
+static void
+print_python_compact_header(grammar_t self, sink_t out)
+{
+    sink_puts(out,
+              "from array import array\n"
+              "import sys\n\n"
+              "def _table(typecode, data):\n"
+              "    table = array(typecode)\n"
+              "    table.frombytes(data)\n"
+              "    if sys.byteorder != 'little':\n"
+              "        table.byteswap()\n"
+              "    return table\n\n");
+}
+
+/* Prints out the shift-reduce table as a flat python array */
+static void
+print_python_compact_shift_reduce_table(grammar_t self, sink_t out)
+{
+    char *type;
+    int size;
+    int i, j;
+
+    /* Actions range from ERR up to the shift to the last kernel */
+    type = python_array_type(self->production_count + self->kernel_count - 1,
+                             1, &size);
+
+    /* Print out the constants needed to decode the actions */
+    sink_printf(out,
+                "ERR = -1\n"
+                "ACC = 0\n"
+                "SHIFT = %d\n"
+                "SR_STRIDE = %d\n\n",
+                self->production_count,
+                self->terminal_count);
+
+    /* Print one bytes literal for each kernel */
+    sink_printf(out, "sr_table = _table('%s', (\n", type);
+    for (i = 0; i < self->kernel_count; i++) {
+        sink_puts(out, "    b'");
+        for (j = 0; j < self->terminal_count; j++) {
+            print_python_bytes(self->kernels[i]->actions[j], size, out);
+        }
+        sink_puts(out, "'\n");
+    }
+
+    sink_puts(out,
+              "))\n\n"
+              "def sr_action(state, terminal):\n"
+              "    return sr_table[state * SR_STRIDE + terminal]\n\n");
+}
+
+/* Prints out the goto table as a flat python array */
+static void
+print_python_compact_goto_table(grammar_t self, sink_t out)
+{
+    char *type;
+    int size;
+    int i, j;
+
+    type = python_array_type(max_state(self), 0, &size);
+    sink_printf(out, "GOTO_STRIDE = %d\n\n", self->nonterminal_count);
+
+    /* Print one bytes literal for each kernel */
+    sink_printf(out, "goto_table = _table('%s', (\n", type);
+    for (i = 0; i < self->kernel_count; i++) {
+        kernel_t kernel = self->kernels[i];
+
+        sink_puts(out, "    b'");
+        for (j = 0; j < self->nonterminal_count; j++) {
+            int ki = kernel->goto_table[j];
+
+            print_python_bytes((ki < 0) ? 0 : ki, size, out);
+        }
+        sink_puts(out, "'\n");
+    }
+
+    sink_puts(out,
+              "))\n\n"
+              "def goto_state(state, nonterminal):\n"
+              "    return goto_table[state * GOTO_STRIDE + nonterminal]\n");
+}
+
+/* Prints a pure-python parser specialized to the python tables.  It
+ * flattens the shift/reduce and goto tables into one list of rows,
+ * numbers states by the offsets of their rows and encodes each
+ * reduction as the complement of its production's index, so that
+ * the loop can classify an action with a single comparison.  The
+ * common one- and two-component reductions are called without
+ * slicing the value stack and overwrite its top in place. */
+static void
+print_python_driver(grammar_t self, sink_t out)
+{
+    sink_printf(out,
+                "_TERMINALS = %d\n"
+                "_WIDTH = %d\n"
+                "_SHIFT = %d\n\n",
+                self->terminal_count,
+                self->terminal_count + self->nonterminal_count,
+                self->production_count);
+
+    sink_puts(out,
+              "class ParseError(Exception):\n"
+              "    \"\"\"Raised with (state, terminal) when a token is not expected\"\"\"\n\n"
+              "def _flatten():\n"
+              "    table = []\n"
+              "    for sr_row, goto_row in zip(sr_table, goto_table):\n"
+              "        for action in sr_row:\n"
+              "            if action >= _SHIFT:\n"
+              "                table.append((action - _SHIFT) * _WIDTH)\n"
+              "            elif action == ERR:\n"
+              "                table.append(~_SHIFT)\n"
+              "            else:\n"
+              "                table.append(~action)\n"
+              "        table.extend([state * _WIDTH for state in goto_row])\n"
+              "    return table\n\n"
+              "_table = _flatten()\n"
+              "_productions = [(reduction, _TERMINALS + nonterm_type, count)\n"
+              "                for reduction, nonterm_type, count in productions]\n\n"
+              "class Parser(object):\n"
+              "    \"\"\"A parser specialized to these tables.  Each reduction is called\n"
+              "    with the rock followed by the values of its production's\n"
+              "    components and returns the new value.\"\"\"\n\n"
+              "    def __init__(self, rock = None):\n"
+              "        self.rock = rock\n"
+              "        self.reset()\n\n"
+              "    def reset(self):\n"
+              "        \"\"\"Discards any partial parse\"\"\"\n"
+              "        self.states = [0]\n"
+              "        self.values = [None]\n\n"
+              "    @property\n"
+              "    def state(self):\n"
+              "        return self.states[-1] // _WIDTH\n\n"
+              "    def feed(self, terminal, value):\n"
+              "        \"\"\"Feeds one token to the parser.  Returns (True, result) if\n"
+              "        it completed a parse, otherwise False.\"\"\"\n"
+              "        table = _table\n"
+              "        states = self.states\n"
+              "        values = self.values\n"
+              "        try:\n"
+              "            while True:\n"
+              "                action = table[states[-1] + terminal]\n"
+              "                if action >= 0:\n"
+              "                    states.append(action)\n"
+              "                    values.append(value)\n"
+              "                    return False\n\n"
+              "                action = ~action\n"
+              "                if action == _SHIFT:\n"
+              "                    raise ParseError(states[-1] // _WIDTH, terminal)\n\n"
+              "                reduction, goto, count = _productions[action]\n"
+              "                if count == 1:\n"
+              "                    result = reduction(self.rock, values[-1])\n"
+              "                elif count == 2:\n"
+              "                    result = reduction(self.rock, values[-2], values[-1])\n"
+              "                    del states[-1], values[-1]\n"
+              "                elif count == 0:\n"
+              "                    result = reduction(self.rock)\n"
+              "                    states.append(0)\n"
+              "                    values.append(None)\n"
+              "                else:\n"
+              "                    top = len(states) - count\n"
+              "                    result = reduction(self.rock, *values[top:])\n"
+              "                    del states[top + 1:], values[top + 1:]\n\n"
+              "                if action == 0:\n"
+              "                    self.reset()\n"
+              "                    return (True, result)\n\n"
+              "                states[-1] = table[states[-2] + goto]\n"
+              "                values[-1] = result\n"
+              "        except:\n"
+              "            self.reset()\n"
+              "            raise\n\n"
+              "    def feed_tokens(self, tokens):\n"
+              "        \"\"\"Feeds an iterable of (terminal, value) pairs to the parser\n"
+              "        and returns the results of the parses they completed.\"\"\"\n"
+              "        table = _table\n"
+              "        productions = _productions\n"
+              "        rock = self.rock\n"
+              "        states = self.states\n"
+              "        values = self.values\n"
+              "        results = []\n"
+              "        try:\n"
+              "            for terminal, value in tokens:\n"
+              "                while True:\n"
+              "                    action = table[states[-1] + terminal]\n"
+              "                    if action >= 0:\n"
+              "                        states.append(action)\n"
+              "                        values.append(value)\n"
+              "                        break\n\n"
+              "                    action = ~action\n"
+              "                    if action == _SHIFT:\n"
+              "                        raise ParseError(states[-1] // _WIDTH, terminal)\n\n"
+              "                    reduction, goto, count = productions[action]\n"
+              "                    if count == 1:\n"
+              "                        result = reduction(rock, values[-1])\n"
+              "                    elif count == 2:\n"
+              "                        result = reduction(rock, values[-2], values[-1])\n"
+              "                        del states[-1], values[-1]\n"
+              "                    elif count == 0:\n"
+              "                        result = reduction(rock)\n"
+              "                        states.append(0)\n"
+              "                        values.append(None)\n"
+              "                    else:\n"
+              "                        top = len(states) - count\n"
+              "                        result = reduction(rock, *values[top:])\n"
+              "                        del states[top + 1:], values[top + 1:]\n\n"
+              "                    if action == 0:\n"
+              "                        del states[1:], values[1:]\n"
+              "                        results.append(result)\n"
+              "                        break\n\n"
+              "                    states[-1] = table[states[-2] + goto]\n"
+              "                    values[-1] = result\n"
+              "        except:\n"
+              "            self.reset()\n"
+              "            raise\n\n"
+              "        return results\n");
 }
 
 /* Print out the parse tables in python format */
 void
-grammar_print_python_tables(grammar_t self, char *module, FILE *out)
+grammar_print_python_tables(grammar_t self, char *module, sink_t out)
 {
     print_python_header(self, module, out);
     print_python_terminals(self, out);
@@ -1490,3 +4778,25 @@ grammar_print_python_tables(grammar_t self, char *module, FILE *out)
     print_python_shift_reduce_table(self, out);
     print_python_goto_table(self, out);
 }
+
+/* Print out the parse tables in python format, packing the
+ * shift/reduce and goto tables into flat arrays */
+void
+grammar_print_python_compact_tables(grammar_t self, char *module, sink_t out)
+{
+    print_python_header(self, module, out);
+    print_python_compact_header(self, out);
+    print_python_terminals(self, out);
+    print_python_reductions(self, module, out);
+    print_python_compact_shift_reduce_table(self, out);
+    print_python_compact_goto_table(self, out);
+}
+
+/* Print out the parse tables in python format followed by a parser
+ * which is specialized to them */
+void
+grammar_print_python_driver(grammar_t self, char *module, sink_t out)
+{
+    grammar_print_python_tables(self, module, out);
+    print_python_driver(self, out);
+}
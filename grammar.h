@@ -42,12 +42,27 @@
 /* The grammar type */
 typedef struct grammar *grammar_t;
 
+/* The supported encodings of shift/reduce table actions */
+enum encoding
+{
+    /* Actions are classified by comparing them against ranges */
+    ENCODING_RANGE,
 
-/* Allocates and initializes a new nonterminal grammar_t */
+    /* The low bits of an action carry its kind */
+    ENCODING_TAGGED
+};
+
+typedef enum encoding encoding_t;
+
+
+/* Allocates and initializes a new nonterminal grammar_t.  The first
+ * production is the first entry point; the start_count productions
+ * numbered in starts are the others. */
 grammar_t grammar_alloc(
     int production_count, production_t *productions,
     int terminal_count, component_t *terminals,
-    int nonterminal_count, component_t *nonterminals);
+    int nonterminal_count, component_t *nonterminals,
+    int start_count, int *starts);
 
 /* Releases the resources consumed by the receiver */
 void grammar_free(grammar_t self);
@@ -56,6 +71,43 @@ void grammar_free(grammar_t self);
 /* Returns the number of components in the grammar */
 int grammar_get_component_count(grammar_t self);
 
+/* Returns the number of kernels (states) in the grammar */
+int grammar_get_kernel_count(grammar_t self);
+
+/* Returns the number of entry points into the grammar */
+int grammar_get_start_count(grammar_t self);
+
+/* Answers nonzero if libtpc performs any of the productions itself,
+ * as it does those made for `*', `+' and `?' */
+int grammar_has_builtins(grammar_t self);
+
+/* Renumbers the kernels so that the most visited come first, given
+ * the number of visits to each of the first count kernels.  The
+ * initial kernel keeps its number.  Returns 0 on success, -1 if
+ * there's no memory */
+int grammar_renumber_kernels(grammar_t self, const unsigned long *visits,
+                             int count);
+
+/* Skips the reductions of unit productions whose reduction is one of
+ * the count named pass-through functions, shifting or going straight
+ * to the kernel the reduction would have reached.  Returns 0 on
+ * success, -1 if there's no memory */
+int grammar_bypass_units(grammar_t self, char **reductions, int count);
+
+/* Merges the kernels which behave identically on every terminal and
+ * nonterminal into one, keeping the initial kernel's number.  Returns
+ * 0 on success, -1 if there's no memory */
+int grammar_minimize(grammar_t self);
+
+/* Inlines each nonterminal with a single production of no more than
+ * size terminals, and which is used by no more than uses productions,
+ * into the productions which use it and rebuilds the kernels.  The
+ * reductions of the inlined productions are folded into functions
+ * which only the runtime and switch tables write out.  The grammar is
+ * left as it was if it has conflicts, or if inlining would add any or
+ * more states.  Returns 0 on success, -1 if there's no memory */
+int grammar_inline(grammar_t self, int size, int uses);
+
 /* Construct a single number to represent a production_t and offset */
 int grammar_encode(grammar_t self, production_t production, int offset);
 
@@ -66,12 +118,50 @@ int grammar_decode(grammar_t self, int code, production_t *production_out);
 void grammar_compute_goto(grammar_t self, int **table, int code);
 
 /* Print out the kernels */
-void grammar_print_kernels(grammar_t self, FILE *out);
+void grammar_print_kernels(grammar_t self, sink_t out);
 
 /* Print out the parse tables in C format */
-void grammar_print_c_tables(grammar_t self, FILE *out);
+void grammar_print_c_tables(grammar_t self, encoding_t encoding, sink_t out);
+
+/* Print out the parse tables for use with the tpc runtime.  If header
+ * is non-NULL then the tables include it rather than declaring the
+ * terminals themselves, and the descriptor is made extern.  Returns 0
+ * on success, -1 if there's no memory */
+int grammar_print_c_runtime_tables(grammar_t self, encoding_t encoding,
+                                   char *header, sink_t out);
+
+/* Print out the parse tables for use with the tpc runtime, with a
+ * switch which calls the reductions in place of a productions table.
+ * Returns 0 on success, -1 if there's no memory */
+int grammar_print_c_switch_tables(grammar_t self, encoding_t encoding,
+                                  char *header, sink_t out);
+
+/* Print out a header, to be included as header, which declares the
+ * terminals, the reductions and the tables of the above */
+void grammar_print_c_runtime_header(grammar_t self, char *header,
+                                    sink_t out);
+
+/* Print out a direct-coded parser in C format */
+void grammar_print_c_code(grammar_t self, sink_t out);
+
+/* Print out the parse tables as a binary table file which can be
+ * loaded with tpc_tables_load().  Returns 0 on success, -1 on failure */
+int grammar_print_binary_tables(grammar_t self, encoding_t encoding,
+                                sink_t out);
+
+/* Print out the parse tables and a parser template in C++ format */
+void grammar_print_cxx(grammar_t self, char *name, sink_t out);
 
 /* Print out the parse tables in python format */
-void grammar_print_python_tables(grammar_t self, char *module, FILE *out);
+void grammar_print_python_tables(grammar_t self, char *module, sink_t out);
+
+/* Print out the parse tables in python format followed by a parser
+ * which is specialized to them */
+void grammar_print_python_driver(grammar_t self, char *module, sink_t out);
+
+/* Print out the parse tables in python format, packing the
+ * shift/reduce and goto tables into flat arrays */
+void grammar_print_python_compact_tables(grammar_t self, char *module,
+                                         sink_t out);
 
 #endif /* GRAMMAR_H */
@@ -40,13 +40,16 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <getopt.h>
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 #include <fcntl.h>
+#include "sink.h"
 #include "component.h"
 #include "production.h"
 #include "grammar.h"
@@ -56,55 +59,260 @@
 
 char *input_filename = NULL;
 char *output_filename = NULL;
+char *header_filename = NULL;
+char *profile_filename = NULL;
+char **pass_through = NULL;
+int pass_through_count = 0;
+int inline_size = 0;
+int inline_uses = INT_MAX;
+int minimize = 0;
 format_t format = FORMAT_C;
+encoding_t encoding = ENCODING_RANGE;
+int encoding_chosen = 0;
+emit_t emit = EMIT_TABLES;
 char *module = NULL;
+char *cxx_namespace = NULL;
 int debug = 0;
 
 /* The list of long options */
 static struct option long_options[] =
 {
     { "output", required_argument, NULL, 'o' },
+    { "header", required_argument, NULL, 'H' },
+    { "profile", required_argument, NULL, 'P' },
+    { "pass-through", required_argument, NULL, 'u' },
+    { "inline", required_argument, NULL, 'i' },
+    { "minimize", no_argument, NULL, 'm' },
     { "c", no_argument, NULL, 'c' },
     { "python", optional_argument, NULL, 'p' },
+    { "binary", no_argument, NULL, 'b' },
+    { "c++", optional_argument, NULL, 'C' },
+    { "action-encoding", required_argument, NULL, 'a' },
+    { "emit", required_argument, NULL, 'e' },
     { "debug", no_argument, NULL, 'd' },
     { "version", no_argument, NULL, 'v' },
     { "help", no_argument, NULL, 'h' },
     { NULL, no_argument, NULL, '\0' }
 };
 
+/* Answers the name by which the tables include their header */
+static char *header_name(void)
+{
+    char *slash;
+
+    if (header_filename == NULL) {
+        return NULL;
+    }
+
+    slash = strrchr(header_filename, '/');
+    return slash == NULL ? header_filename : slash + 1;
+}
+
+/* Print out the header which declares the tables */
+static void print_header(grammar_t grammar)
+{
+    FILE *file;
+    sink_t out;
+
+    if ((file = fopen(header_filename, "w")) == NULL) {
+        perror("unable to open header for write");
+        exit(1);
+    }
+
+    if ((out = sink_alloc(file)) == NULL) {
+        perror("sink_alloc(): failed");
+        exit(1);
+    }
+
+    grammar_print_c_runtime_header(grammar, header_name(), out);
+    if (sink_free(out) < 0 || fclose(file) != 0) {
+        perror("unable to write header");
+        exit(1);
+    }
+}
+
 /* Print out the parse tables */
-static void print_tables(grammar_t grammar, FILE *out)
+static void print_tables(grammar_t grammar, FILE *file)
 {
+    sink_t out;
+
+    /* Buffer the output on its way to the file */
+    if ((out = sink_alloc(file)) == NULL) {
+        perror("sink_alloc(): failed");
+        exit(1);
+    }
+
     /* Write the parse table to the file */
     switch (format) {
     case FORMAT_C:
-        grammar_print_c_tables(grammar, out);
+        if (emit == EMIT_CODE) {
+            grammar_print_c_code(grammar, out);
+        } else if (emit == EMIT_RUNTIME) {
+            if (grammar_print_c_runtime_tables(grammar, encoding,
+                                               header_name(), out) < 0) {
+                perror("unable to write runtime tables");
+                exit(1);
+            }
+        } else if (emit == EMIT_SWITCH) {
+            if (grammar_print_c_switch_tables(grammar, encoding,
+                                              header_name(), out) < 0) {
+                perror("unable to write switch tables");
+                exit(1);
+            }
+        } else {
+            grammar_print_c_tables(grammar, encoding, out);
+        }
         break;
 
     case FORMAT_PYTHON:
-        grammar_print_python_tables(grammar, module, out);
+        if (emit == EMIT_COMPACT) {
+            grammar_print_python_compact_tables(grammar, module, out);
+        } else if (emit == EMIT_DRIVER) {
+            grammar_print_python_driver(grammar, module, out);
+        } else {
+            grammar_print_python_tables(grammar, module, out);
+        }
+        break;
+
+    case FORMAT_CXX:
+        grammar_print_cxx(grammar, cxx_namespace, out);
+        break;
+
+    case FORMAT_BINARY:
+        if (grammar_print_binary_tables(grammar, encoding, out) < 0) {
+            perror("unable to write binary tables");
+            exit(1);
+        }
         break;
 
     default:
         /* Should never get here */
         fprintf(stderr, "*** Unrecognized format %d\n", format);
     }
+
+    /* Write out whatever is left */
+    if (sink_free(out) < 0) {
+        perror("unable to write tables");
+        exit(1);
+    }
+}
+
+/* Reads a profile of visits to each state and renumbers the
+ * grammar's kernels to match */
+static void apply_profile(grammar_t grammar)
+{
+    int count = grammar_get_kernel_count(grammar);
+    char buffer[BUFFER_SIZE];
+    unsigned long *visits;
+    unsigned long value;
+    FILE *file;
+    int line = 0;
+    int state;
+
+    if ((file = fopen(profile_filename, "r")) == NULL) {
+        perror("unable to open profile for read");
+        exit(1);
+    }
+
+    visits = (unsigned long *)calloc(count, sizeof(unsigned long));
+    if (visits == NULL) {
+        perror("calloc(): failed");
+        exit(1);
+    }
+
+    /* Each line holds a state and its visits; skip blanks and comments */
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        char *start = buffer + strspn(buffer, " \t\r\n");
+
+        line++;
+        if (*start == '\0' || *start == '#') {
+            continue;
+        }
+
+        if (sscanf(start, "%d %lu", &state, &value) != 2 ||
+            state < 0 || ! (state < count)) {
+            fprintf(stderr, "%s:%d: bad profile entry\n",
+                    profile_filename, line);
+            exit(1);
+        }
+
+        visits[state] += value;
+    }
+
+    fclose(file);
+    if (grammar_renumber_kernels(grammar, visits, count) < 0) {
+        perror("grammar_renumber_kernels(): failed");
+        exit(1);
+    }
+
+    free(visits);
 }
 
 /* Print the production rule */
 static void parser_cb(void *ignored, grammar_t grammar)
 {
     FILE *file;
+    sink_t log;
+
+    /* Only libtpc knows how to begin at another entry point */
+    if (grammar_get_start_count(grammar) > 1 &&
+        (format != FORMAT_C ||
+         (emit != EMIT_RUNTIME && emit != EMIT_SWITCH))) {
+        fprintf(stderr, "%%start needs the C runtime or switch output\n");
+        exit(1);
+    }
+
+    /* Nor how to build the lists and options of `*', `+' and `?' */
+    if (grammar_has_builtins(grammar) &&
+        format != FORMAT_BINARY &&
+        (format != FORMAT_C ||
+         (emit != EMIT_RUNTIME && emit != EMIT_SWITCH))) {
+        fprintf(stderr, "`*', `+' and `?' need the C runtime, switch "
+                "or binary output\n");
+        exit(1);
+    }
+
+    /* Fold the small nonterminals into the productions which use them */
+    if (inline_size != 0 &&
+        grammar_inline(grammar, inline_size, inline_uses) < 0) {
+        perror("grammar_inline(): failed");
+        exit(1);
+    }
+
+    /* Skip the unit reductions which just pass their value along */
+    if (pass_through_count != 0 &&
+        grammar_bypass_units(grammar, pass_through, pass_through_count) < 0) {
+        perror("grammar_bypass_units(): failed");
+        exit(1);
+    }
+
+    /* Merge the states which behave identically */
+    if (minimize && grammar_minimize(grammar) < 0) {
+        perror("grammar_minimize(): failed");
+        exit(1);
+    }
+
+    /* Put the hottest states first if we have a profile */
+    if (profile_filename != NULL) {
+        apply_profile(grammar);
+    }
 
     /* Print the kernels if debug is on */
-    if (debug) {
-        grammar_print_kernels(grammar, stderr);
+    if (debug && (log = sink_alloc(stderr)) != NULL) {
+        grammar_print_kernels(grammar, log);
+        sink_free(log);
+    }
+
+    /* Write the header if one was asked for */
+    if (header_filename != NULL) {
+        print_header(grammar);
     }
 
     /* If an output filename was specified then write to it */
     if (output_filename != NULL) {
         /* Try to open the output file */
-        if ((file = fopen(output_filename, "w")) == NULL) {
+        if ((file = fopen(output_filename,
+                           format == FORMAT_BINARY ? "wb" : "w")) == NULL) {
             perror("unable to open file for write");
             exit(1);
         }
@@ -123,8 +331,17 @@ static void usage(int argc, char *argv[])
 {
     fprintf(stderr, "usage: %s [OPTION]... [FILE]\n", argv[0]);
     fprintf(stderr, "  -o file,     --output=file\n");
+    fprintf(stderr, "  -H file,     --header=file\n");
+    fprintf(stderr, "  -P file,     --profile=file\n");
+    fprintf(stderr, "  -u function, --pass-through=function\n");
+    fprintf(stderr, "  -i size[,uses], --inline=size[,uses]\n");
+    fprintf(stderr, "  -m,          --minimize\n");
     fprintf(stderr, "  -c,          --c\n");
     fprintf(stderr, "  -p,          --python[=import-module]\n");
+    fprintf(stderr, "  -b,          --binary\n");
+    fprintf(stderr, "  -C,          --c++[=namespace]\n");
+    fprintf(stderr, "  -a encoding, --action-encoding=range|tagged\n");
+    fprintf(stderr, "  -e output,   --emit=tables|code|runtime|compact|driver|switch\n");
     fprintf(stderr, "  -d,          --debug\n");
     fprintf(stderr, "  -q,          --quiet\n");
     fprintf(stderr, "  -v,          --version\n");
@@ -140,7 +357,7 @@ int main(int argc, char *argv[])
     int fd;
 
     /* Read options from the command line */
-    while ((choice = getopt_long(argc, argv, "o:cp?dqvh",
+    while ((choice = getopt_long(argc, argv, "o:H:P:u:i:mcp?bCa:e:dqvh",
                                  long_options, NULL)) != -1) {
         switch (choice) {
         case 'o':
@@ -148,6 +365,54 @@ int main(int argc, char *argv[])
             output_filename = optarg;
             break;
 
+        case 'H':
+            /* --header or -H */
+            header_filename = optarg;
+            break;
+
+        case 'P':
+            /* --profile or -P */
+            profile_filename = optarg;
+            break;
+
+        case 'u':
+            /* --pass-through or -u */
+            pass_through = (char **)realloc(
+                pass_through, (pass_through_count + 1) * sizeof(char *));
+            if (pass_through == NULL) {
+                perror("realloc(): failed");
+                exit(1);
+            }
+
+            pass_through[pass_through_count++] = optarg;
+            break;
+
+        case 'i':
+            /* --inline or -i */
+            switch (sscanf(optarg, "%d,%d", &inline_size, &inline_uses)) {
+            case 1:
+                inline_uses = INT_MAX;
+                break;
+
+            case 2:
+                break;
+
+            default:
+                usage(argc, argv);
+                exit(1);
+            }
+
+            if (inline_size < 1 || inline_uses < 1) {
+                usage(argc, argv);
+                exit(1);
+            }
+            break;
+
+        case 'm':
+            /* --minimize or -m */
+            minimize = 1;
+            break;
+
         case 'c':
             /* --c or -c */
             format = FORMAT_C;
@@ -159,6 +424,50 @@ int main(int argc, char *argv[])
             module = optarg;
             break;
 
+        case 'b':
+            /* --binary or -b */
+            format = FORMAT_BINARY;
+            break;
+
+        case 'C':
+            /* --c++ or -C */
+            format = FORMAT_CXX;
+            cxx_namespace = optarg;
+            break;
+
+        case 'a':
+            /* --action-encoding or -a */
+            encoding_chosen = 1;
+            if (strcmp(optarg, "range") == 0) {
+                encoding = ENCODING_RANGE;
+            } else if (strcmp(optarg, "tagged") == 0) {
+                encoding = ENCODING_TAGGED;
+            } else {
+                usage(argc, argv);
+                exit(1);
+            }
+            break;
+
+        case 'e':
+            /* --emit or -e */
+            if (strcmp(optarg, "tables") == 0) {
+                emit = EMIT_TABLES;
+            } else if (strcmp(optarg, "code") == 0) {
+                emit = EMIT_CODE;
+            } else if (strcmp(optarg, "runtime") == 0) {
+                emit = EMIT_RUNTIME;
+            } else if (strcmp(optarg, "compact") == 0) {
+                emit = EMIT_COMPACT;
+            } else if (strcmp(optarg, "driver") == 0) {
+                emit = EMIT_DRIVER;
+            } else if (strcmp(optarg, "switch") == 0) {
+                emit = EMIT_SWITCH;
+            } else {
+                usage(argc, argv);
+                exit(1);
+            }
+            break;
+
         case 'd':
             /* --debug or -d */
             debug = 1;
@@ -191,8 +500,20 @@ int main(int argc, char *argv[])
         input_filename = argv[optind++];
     }
 
-    /* Make sure we don't have any extra args */
-    if (optind < argc) {
+    /* Make sure we don't have any extra args or nonsensical combinations */
+    if (optind < argc ||
+        ((emit == EMIT_COMPACT || emit == EMIT_DRIVER) &&
+         format != FORMAT_PYTHON) ||
+        ((emit == EMIT_CODE || emit == EMIT_RUNTIME ||
+          emit == EMIT_SWITCH) && format != FORMAT_C) ||
+        (encoding_chosen && format != FORMAT_BINARY &&
+         (format != FORMAT_C || emit == EMIT_CODE)) ||
+        (inline_size != 0 &&
+         (format != FORMAT_C ||
+          (emit != EMIT_RUNTIME && emit != EMIT_SWITCH))) ||
+        (header_filename != NULL &&
+         (format != FORMAT_C ||
+          (emit != EMIT_RUNTIME && emit != EMIT_SWITCH)))) {
         usage(argc, argv);
         exit(1);
     }
@@ -44,23 +44,33 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include "sink.h"
 #include "component.h"
 #include "production.h"
 #include "grammar.h"
 #include "parser.h"
 
-typedef void *(*reduction_t)(parser_t self);
+#include "tpc_runtime.h"
 
 /* Prototypes for the reduction functions */
-static void *accept_grammar(parser_t self);
-static void *extend_production_list(parser_t self);
-static void *make_production_list(parser_t self);
-static void *make_production(parser_t self);
-static void *extend_exp_list(parser_t self);
-static void *make_exp_list(parser_t self);
-static void *make_nonterminal(parser_t self);
-static void *make_terminal(parser_t self);
-static void *make_reduction(parser_t self);
+static int accept_grammar(void *rock, tpc_frame_t *args, void **result_out);
+static int make_production(void *rock, tpc_frame_t *args, void **result_out);
+static int make_prec_production(void *rock, tpc_frame_t *args,
+                                void **result_out);
+static int make_left_precedence(void *rock, tpc_frame_t *args,
+                                void **result_out);
+static int make_right_precedence(void *rock, tpc_frame_t *args,
+                                 void **result_out);
+static int make_nonassoc_precedence(void *rock, tpc_frame_t *args,
+                                    void **result_out);
+static int make_start(void *rock, tpc_frame_t *args, void **result_out);
+static int make_exp(void *rock, tpc_frame_t *args, void **result_out);
+static int make_star(void *rock, tpc_frame_t *args, void **result_out);
+static int make_plus(void *rock, tpc_frame_t *args, void **result_out);
+static int make_optional(void *rock, tpc_frame_t *args, void **result_out);
+static int make_nonterminal(void *rock, tpc_frame_t *args, void **result_out);
+static int make_terminal(void *rock, tpc_frame_t *args, void **result_out);
+static int make_reduction(void *rock, tpc_frame_t *args, void **result_out);
 
 #include "pcg.h"
 
@@ -70,6 +80,19 @@ static void *make_reduction(parser_t self);
 /* The type of a lexer state */
 typedef int (*lexer_state_t)(parser_t self, int ch);
 
+/* A nonterminal made for a component followed by `*', `+' or `?' */
+struct repetition
+{
+    /* The component */
+    component_t component;
+
+    /* The operator which followed it */
+    int operator;
+
+    /* The nonterminal which stands for them */
+    component_t nonterminal;
+};
+
 
 /* The parser data structure */
 struct parser
@@ -83,20 +106,8 @@ struct parser
     /* The filename from which we're reading */
     char *filename;
 
-    /* The parser's state stack */
-    int *state_stack;
-
-    /* The end of the state stack */
-    int *state_end;
-
-    /* The top of the state stack */
-    int *state_top;
-
-    /* The parser's value stack */
-    void **value_stack;
-
-    /* The top of the value stack */
-    void **value_top;
+    /* The runtime parser which drives the parse tables */
+    tpc_parser_t driver;
 
     /* The line currently being read */
     int line;
@@ -128,17 +139,26 @@ struct parser
     /* The nonterminal symbols */
     component_t *nonterminals;
 
-    /* The number of components in the current production */
-    int component_count;
+    /* The number of repeated or optional components */
+    int repetition_count;
 
-    /* The components of the current production */
-    component_t *components;
+    /* The repeated or optional components */
+    struct repetition *repetitions;
 
     /* The number of productions */
     int production_count;
 
     /* The productions */
     production_t *productions;
+
+    /* The number of precedence levels declared so far */
+    int precedence_count;
+
+    /* The number of nonterminals declared with %start */
+    int start_count;
+
+    /* The nonterminals declared with %start */
+    component_t *starts;
 };
 
 
@@ -147,189 +167,133 @@ static int lex_start(parser_t self, int ch);
 static int lex_comment(parser_t self, int ch);
 static int lex_colon(parser_t self, int ch);
 static int lex_colon_colon(parser_t self, int ch);
+static int lex_directive(parser_t self, int ch);
 static int lex_id(parser_t self, int ch);
 static int lex_error(parser_t self, int ch);
 
 
-/* Expands the stack */
-static int
-grow_stack(parser_t self)
+/* Answers how a kind of terminal is described in error messages */
+static char *
+describe_terminal(terminal_t type)
 {
-    size_t new_count = (self->state_end - self->state_top) * 2;
-    int *new_state_stack;
-    void **new_value_stack;
+    switch (type) {
+    case TT_EOF:
+        return "end of file";
 
-    /* Try to allocate more memory for the state stack */
-    new_state_stack = (int *)realloc(self->state_stack,
-                                     new_count * sizeof(int));
-    if (new_state_stack == NULL) {
-	return -1;
-    }
+    case TT_DERIVES:
+        return "`::='";
 
-    /* Try to allocate memory for the new value stack */
-    new_value_stack = (void **)realloc(self->value_stack,
-                                       new_count * sizeof(void *));
-    if (new_value_stack == NULL) {
-	return -1;
-    }
+    case TT_PREC:
+        return "`%prec'";
 
-    /* Update the pointers */
-    self->state_end = new_state_stack + new_count;
-    self->state_top = self->state_top - self->state_stack + new_state_stack;
-    self->state_stack = new_state_stack;
+    case TT_LEFT:
+        return "`%left'";
 
-    self->value_top = self->value_top - self->value_stack + new_value_stack;
-    self->value_stack = new_value_stack;
-    return 0;
-}
+    case TT_RIGHT:
+        return "`%right'";
 
-/* Push a state and value onto the stack */
-static int
-push(parser_t self, int state, void *value)
-{
-    if (! (self->state_top < self->state_end)) {
-	if (grow_stack(self) < 0) {
-	    return -1;
-	}
-    }
+    case TT_NONASSOC:
+        return "`%nonassoc'";
 
-    /* The state stack is pre-increment */
-    *(++self->state_top) = state;
+    case TT_START:
+        return "`%start'";
 
-    /* The value stack is post-increment */
-    *(self->value_top++) = value;
+    case TT_LT:
+        return "`<'";
 
-    return 0;
-}
+    case TT_ID:
+        return "identifier";
 
-/* Move the top of the stack back `count' positions */
-static void
-pop(parser_t self, int count)
-{
-    if (self->state_stack > self->state_top - count) {
-	fprintf(stderr, "pop underflow\n");
-	abort();
-    }
+    case TT_GT:
+        return "`>'";
 
-    self->state_top -= count;
-    self->value_top -= count;
-}
+    case TT_LBRACKET:
+        return "`['";
 
-/* Returns the top of the state stack */
-static int
-top(parser_t self)
-{
-    return *(self->state_top);
-}
+    case TT_RBRACKET:
+        return "`]'";
+
+    case TT_STAR:
+        return "`*'";
+
+    case TT_PLUS:
+        return "`+'";
 
+    case TT_QUESTION:
+        return "`?'";
+
+    default:
+        abort();
+    }
+}
 
 /* Prints an error message */
 static void
 print_parse_error(parser_t self, terminal_t type)
 {
-    char *token;
     char *file = self->filename == NULL ? "<stdin>" : self->filename;
+    int expected[sizeof(terminal_names) / sizeof(char *)];
+    size_t count, i;
 
     /* Convert the token back into a string */
     switch (type) {
     case TT_EOF:
-        fprintf(stderr, "%s:%d: unexpected end of file\n", file, self->line);
-        return;
-
-    case TT_DERIVES:
-        token = "::=";
-        break;
-
-    case TT_LT:
-        token = "<";
+        fprintf(stderr, "%s:%d: unexpected end of file", file, self->line);
         break;
 
     case TT_ID:
-        token = self->token;
-        break;
-
-    case TT_GT:
-        token = ">";
+        fprintf(stderr, "%s:%d: parse error before `%s'",
+                file, self->line, self->token);
         break;
 
-    case TT_LBRACKET:
-        token = "[";
-        break;
-
-    case TT_RBRACKET:
-        token = "]";
+    default:
+        fprintf(stderr, "%s:%d: parse error before %s",
+                file, self->line, describe_terminal(type));
         break;
+    }
 
-    default:
-        abort();
+    /* List the terminals which would have been acceptable */
+    count = tpc_parser_get_expected(self->driver, expected,
+                                    sizeof(expected) / sizeof(int));
+    for (i = 0; i < count; i++) {
+        fprintf(stderr, "%s%s",
+                i == 0 ? "; expected " : i + 1 == count ? " or " : ", ",
+                describe_terminal(expected[i]));
     }
 
-    fprintf(stderr, "%s:%d: parse error before `%s'\n",
-            file, self->line, token);
+    fprintf(stderr, "\n");
 }
 
 /* Perform all possible reductions and then shift in the terminal */
 static int
 shift_reduce(parser_t self, terminal_t type, void *value)
 {
-    int action;
     void *result;
 
-    /* Reduce as many times as possible */
-    while (IS_REDUCE(action = sr_table[top(self)][type])) {
-	struct production *production;
-	int reduction;
-
-	/* Locate the production we're going to use to do the reduction */
-	reduction = REDUCTION(action);
-	production = productions + reduction;
-
-	/* Point the stack to the beginning of the components */
-	pop(self, production->count);
-
-	/* Reduce by calling the production's reduction */
-	if ((result = production->reduction(self)) == NULL) {
-	    fprintf(stderr, "reduce error\n");
-	    abort();
-	}
-
-	/* Push the result of the reduction back onto the stack */
-	if (push(self, REDUCE_GOTO(top(self), production), result) < 0) {
-	    fprintf(stderr, "push error\n");
-	    abort();
-	}
-    }
-
-    /* Can we shift? */
-    if (IS_SHIFT(action)) {
-	return push(self, SHIFT_GOTO(action), value);
-    }
-
-    /* Can we accept? */
-    if (IS_ACCEPT(action)) {
-	/* Set up the stack */
-	pop(self, 1);
-
-	/* Finish parsing */
-	if ((result = accept_grammar(self)) == NULL) {
-	    return -1;
-	}
+    switch (tpc_parser_feed(self->driver, type, value, &result)) {
+    case TPC_OK:
+	return 0;
 
+    case TPC_ACCEPT:
 	/* Deliver the grammar to the callback */
 	if (self->callback != NULL) {
 	    self->callback(self->rock, result);
 	}
 
 	return 0;
-    }
 
-    /* Watch for errors */
-    if (IS_ERROR(action)) {
+    case TPC_ERR_SYNTAX:
 	print_parse_error(self, type);
 	return -1;
-    }
 
-    return 0;
+    case TPC_ERR_NOMEM:
+	fprintf(stderr, "push error\n");
+	return -1;
+
+    default:
+	/* The reduction will have explained what went wrong */
+	return -1;
+    }
 }
 
 static int
@@ -380,6 +344,51 @@ accept_derives(parser_t self)
     return shift_reduce(self, TT_DERIVES, NULL);
 }
 
+static int
+accept_star(parser_t self)
+{
+    return shift_reduce(self, TT_STAR, NULL);
+}
+
+static int
+accept_plus(parser_t self)
+{
+    return shift_reduce(self, TT_PLUS, NULL);
+}
+
+static int
+accept_question(parser_t self)
+{
+    return shift_reduce(self, TT_QUESTION, NULL);
+}
+
+/* Accepts a `%' followed by the name of a directive */
+static int
+accept_directive(parser_t self, char *directive)
+{
+    if (strcmp(directive, "%prec") == 0) {
+        return shift_reduce(self, TT_PREC, NULL);
+    }
+
+    if (strcmp(directive, "%left") == 0) {
+        return shift_reduce(self, TT_LEFT, NULL);
+    }
+
+    if (strcmp(directive, "%right") == 0) {
+        return shift_reduce(self, TT_RIGHT, NULL);
+    }
+
+    if (strcmp(directive, "%nonassoc") == 0) {
+        return shift_reduce(self, TT_NONASSOC, NULL);
+    }
+
+    if (strcmp(directive, "%start") == 0) {
+        return shift_reduce(self, TT_START, NULL);
+    }
+
+    return accept_error(self, directive);
+}
+
 static int
 accept_id(parser_t self, char *id)
 {
@@ -457,6 +466,16 @@ lex_start(parser_t self, int ch)
         self->lex_state = lex_colon;
         return 0;
 
+    case '%':
+	/* Watch for a directive */
+        self->point = self->token;
+        if (append_char(self, ch) < 0) {
+            return -1;
+        }
+
+        self->lex_state = lex_directive;
+        return 0;
+
     case '<':
 	/* Watch for a less-than symbol */
         self->lex_state = lex_start;
@@ -476,6 +495,21 @@ lex_start(parser_t self, int ch)
 	/* Watch for a right square bracket */
         self->lex_state = lex_start;
         return accept_rbracket(self);
+
+    case '*':
+	/* Watch for a star */
+        self->lex_state = lex_start;
+        return accept_star(self);
+
+    case '+':
+	/* Watch for a plus sign */
+        self->lex_state = lex_start;
+        return accept_plus(self);
+
+    case '?':
+	/* Watch for a question mark */
+        self->lex_state = lex_start;
+        return accept_question(self);
     }
 
     /* Skip whitespace */
@@ -543,6 +577,34 @@ lex_colon_colon(parser_t self, int ch)
     return lex_error(self, ch);
 }
 
+/* We've seen a `%'.  Read the name of the directive */
+static int
+lex_directive(parser_t self, int ch)
+{
+    /* Watch for additional directive characters */
+    if (isalpha(ch)) {
+	if (append_char(self, ch) < 0) {
+	    return -1;
+	}
+
+	self->lex_state = lex_directive;
+	return 0;
+    }
+
+    /* Null-terminate the directive */
+    if (append_char(self, 0) < 0) {
+	return -1;
+    }
+
+    /* Accept the token */
+    if (accept_directive(self, self->token) < 0) {
+	return -1;
+    }
+
+    /* Scan the character again from the start state */
+    return lex_start(self, ch);
+}
+
 static int
 lex_id(parser_t self, int ch)
 {
@@ -629,6 +691,24 @@ intern_terminal(parser_t self, char *name)
     return component;
 }
 
+/* Adds a new nonterminal with the given name */
+static component_t
+add_nonterminal(parser_t self, char *name)
+{
+    component_t component;
+
+    component = nonterminal_alloc(self->filename, self->id_token_line,
+                                  name, self->nonterminal_count);
+
+    /* Make space for it in the table */
+    self->nonterminals = (component_t *)realloc(self->nonterminals,
+                                                (self->nonterminal_count + 1) *
+                                                sizeof(component_t));
+    self->nonterminals[self->nonterminal_count++] = component;
+
+    return component;
+}
+
 /* Returns the nonterminal_t with the given name, creating it if necessary */
 static component_t
 intern_nonterminal(parser_t self, char *name)
@@ -645,143 +725,478 @@ intern_nonterminal(parser_t self, char *name)
     }
 
     /* Not there so create one */
-    component = nonterminal_alloc(self->filename, self->id_token_line,
-                                  name, self->nonterminal_count);
+    return add_nonterminal(self, name);
+}
+
+/* Returns the nonterminal which stands for the component followed by
+ * the operator, creating it if necessary */
+static component_t
+intern_repetition(parser_t self, component_t component, int operator)
+{
+    struct repetition *repetition;
+    char *name;
+    int index;
+
+    /* See if we've already encountered this repetition */
+    for (index = 0; index < self->repetition_count; index++) {
+        repetition = self->repetitions + index;
+        if (repetition->component == component &&
+            repetition->operator == operator) {
+            return repetition->nonterminal;
+        }
+    }
 
     /* Make space for it in the table */
-    self->nonterminals = (component_t *)realloc(self->nonterminals,
-                                                (self->nonterminal_count + 1) *
-                                                sizeof(component_t));
-    self->nonterminals[self->nonterminal_count++] = component;
+    repetition = (struct repetition *)realloc(
+        self->repetitions,
+        (self->repetition_count + 1) * sizeof(struct repetition));
+    if (repetition == NULL) {
+        return NULL;
+    }
 
-    return component;
+    self->repetitions = repetition;
+    repetition += self->repetition_count;
+
+    /* Name its nonterminal after the component and operator */
+    name = (char *)malloc(strlen(component_get_name(component)) + 2);
+    if (name == NULL) {
+        return NULL;
+    }
+
+    sprintf(name, "%s%c", component_get_name(component), operator);
+    repetition->component = component;
+    repetition->operator = operator;
+    repetition->nonterminal = add_nonterminal(self, name);
+    free(name);
+
+    if (repetition->nonterminal == NULL) {
+        return NULL;
+    }
+
+    self->repetition_count++;
+    return repetition->nonterminal;
 }
 
-/* Adds a component to the production */
-static void
-add_component(parser_t self, component_t component)
+/* Adds a production of one or two components with one of libtpc's
+ * own reductions to the end of the list */
+static int
+add_builtin_production(parser_t self, component_t nonterminal,
+                       int count, component_t first, component_t second,
+                       char *reduction)
 {
-    self->components = (component_t *)realloc(self->components,
-                                              (self->component_count + 1) *
-                                              sizeof(component_t));
-    self->components[self->component_count++] = component;
+    component_t *components = NULL;
+    production_t production;
+
+    if (count != 0) {
+        components = (component_t *)malloc(count * sizeof(component_t));
+        if (components == NULL) {
+            return -1;
+        }
+
+        components[0] = first;
+        if (count > 1) {
+            components[1] = second;
+        }
+    }
+
+    production = production_alloc(self->production_count, nonterminal,
+                                  count, components, reduction);
+    if (production == NULL) {
+        free(components);
+        return -1;
+    }
+
+    self->productions[self->production_count++] = production;
+    return 0;
 }
 
-/* Adds a production to the list */
-static void
-add_production(parser_t self, production_t production)
+/* Adds the productions of a repeated or optional component */
+static int
+add_repetition_productions(parser_t self, struct repetition *repetition)
 {
-    self->productions = (production_t *)realloc(self->productions,
-                                                (self->production_count + 1) *
-                                                sizeof(production_t));
-    self->productions[self->production_count++] = production;
+    component_t nonterminal = repetition->nonterminal;
+    component_t component = repetition->component;
+
+    switch (repetition->operator) {
+    case '*':
+        /* <X*> ::= | <X*> X */
+        if (add_builtin_production(self, nonterminal, 0, NULL, NULL,
+                                   "tpc_list_empty") < 0) {
+            return -1;
+        }
+
+        return add_builtin_production(self, nonterminal, 2,
+                                      nonterminal, component,
+                                      "tpc_list_append");
+
+    case '+':
+        /* <X+> ::= X | <X+> X */
+        if (add_builtin_production(self, nonterminal, 1, component, NULL,
+                                   "tpc_list_one") < 0) {
+            return -1;
+        }
+
+        return add_builtin_production(self, nonterminal, 2,
+                                      nonterminal, component,
+                                      "tpc_list_append");
+
+    default:
+        /* <X?> ::= | X */
+        if (add_builtin_production(self, nonterminal, 0, NULL, NULL,
+                                   "tpc_option_none") < 0) {
+            return -1;
+        }
+
+        return add_builtin_production(self, nonterminal, 1,
+                                      component, NULL,
+                                      "tpc_option_some");
+    }
+}
+
+/* Adds a nonterminal and production <X$> ::= <X> for each %start
+ * nonterminal, answering their indices in an array or NULL */
+static int *
+add_start_productions(parser_t self)
+{
+    component_t nonterminal;
+    int *starts;
+    char *name;
+    int i;
+
+    if ((starts = (int *)malloc((self->start_count + 1) *
+                                sizeof(int))) == NULL) {
+        return NULL;
+    }
+
+    for (i = 0; i < self->start_count; i++) {
+        component_t start = self->starts[i];
+
+        /* The first production's is already an entry point */
+        if (self->production_count != 0 &&
+            production_get_nonterminal_index(self->productions[0]) ==
+            component_get_index(start)) {
+            char *file;
+            int line = component_get_origin(start, &file);
+
+            fprintf(stderr, "%s:%d: `%s' is already the start symbol\n",
+                    file == NULL ? "<stdin>" : file, line,
+                    component_get_name(start));
+            free(starts);
+            return NULL;
+        }
+
+        name = (char *)malloc(strlen(component_get_name(start)) + 2);
+        if (name == NULL) {
+            free(starts);
+            return NULL;
+        }
+
+        sprintf(name, "%s$", component_get_name(start));
+        nonterminal = add_nonterminal(self, name);
+        free(name);
+
+        starts[i] = self->production_count;
+        if (nonterminal == NULL ||
+            add_builtin_production(self, nonterminal, 1, start, NULL,
+                                   "tpc_pass") < 0) {
+            free(starts);
+            return NULL;
+        }
+    }
+
+    return starts;
+}
+
+/* Makes a production of the components in the list, which it frees */
+static int
+new_production(parser_t self, component_t nonterminal, tpc_list_t *list,
+               char *reduction, component_t precedence, void **result_out)
+{
+    component_t *components = NULL;
+    production_t production;
+    int count = (int)list->count;
+    int index;
+
+    /* Copy the components into an array of their own */
+    if (count != 0) {
+        components = (component_t *)malloc(count * sizeof(component_t));
+        if (components == NULL) {
+            tpc_list_free(list);
+            return -1;
+        }
+
+        for (index = 0; index < count; index++) {
+            components[index] = (component_t)list->values[index];
+        }
+    }
+
+    tpc_list_free(list);
+
+    production = production_alloc(self->production_count, nonterminal,
+                                  count, components, reduction);
+    if (production == NULL) {
+        free(components);
+        return -1;
+    }
+
+    if (precedence != NULL) {
+        production_set_precedence(production, precedence);
+    }
+
+    self->production_count++;
+    *result_out = production;
+    return 0;
 }
 
 
-/* <grammar> ::= <production-list> */
-static void *
-accept_grammar(parser_t self)
+/* <grammar> ::= <declaration>+ */
+static int
+accept_grammar(void *rock, tpc_frame_t *args, void **result_out)
 {
+    parser_t self = (parser_t)rock;
+    tpc_list_t *declarations = (tpc_list_t *)args[0].value;
     grammar_t grammar;
+    size_t index;
+    int *starts;
+    int count = 0;
+    int i;
+
+    /* Precedence declarations alone make no grammar */
+    if (self->production_count == 0) {
+        fprintf(stderr, "%s:%d: the grammar has no productions\n",
+                self->filename == NULL ? "<stdin>" : self->filename,
+                self->line);
+        tpc_list_free(declarations);
+        return -1;
+    }
+
+    /* Make room for the productions, two for each repetition and one
+     * for each entry point */
+    self->productions = (production_t *)malloc(
+        (self->production_count + 2 * self->repetition_count +
+         self->start_count) * sizeof(production_t));
+    if (self->productions == NULL) {
+        tpc_list_free(declarations);
+        return -1;
+    }
+
+    /* Precedence and %start declarations have no value */
+    for (index = 0; index < declarations->count; index++) {
+        if (declarations->values[index] != NULL) {
+            self->productions[count++] =
+                (production_t)declarations->values[index];
+        }
+    }
+
+    tpc_list_free(declarations);
+
+    /* The repetitions' productions go after everything else */
+    for (i = 0; i < self->repetition_count; i++) {
+        if (add_repetition_productions(self, self->repetitions + i) < 0) {
+            return -1;
+        }
+    }
+
+    /* And the entry points' after those */
+    if ((starts = add_start_productions(self)) == NULL) {
+        return -1;
+    }
 
     grammar = grammar_alloc(self->production_count, self->productions,
                             self->terminal_count, self->terminals,
-                            self->nonterminal_count, self->nonterminals);
+                            self->nonterminal_count, self->nonterminals,
+                            self->start_count, starts);
+    free(starts);
     if (grammar == NULL) {
-	return NULL;
+	return -1;
     }
 
     /* Clear our fields so that we can safely be freed */
     self->terminals = NULL;
     self->nonterminals = NULL;
     self->productions = NULL;
-    return grammar;
+    *result_out = grammar;
+    return 0;
 }
 
-/* <production-list> ::= <production-list> <production> */
-static void *
-extend_production_list(parser_t self)
+/* <declaration> ::= <nonterminal> DERIVES <exp>* <reduction> */
+static int
+make_production(void *rock, tpc_frame_t *args, void **result_out)
 {
-    add_production(self, (production_t)self->value_top[1]);
-    return self->productions;
+    return new_production((parser_t)rock,
+                          (component_t)args[0].value,
+                          (tpc_list_t *)args[2].value,
+                          (char *)args[3].value,
+                          NULL, result_out);
 }
 
-/* <production-list> ::= <production> */
-static void *
-make_production_list(parser_t self)
+/* <declaration> ::= <nonterminal> DERIVES <exp>* PREC <terminal>
+ *                   <reduction> */
+static int
+make_prec_production(void *rock, tpc_frame_t *args, void **result_out)
 {
-    production_t production = (production_t)self->value_top[0];
-    add_production(self, production);
-/*    production_set_index(production, index);*/
-    return self->productions;
+    return new_production((parser_t)rock,
+                          (component_t)args[0].value,
+                          (tpc_list_t *)args[2].value,
+                          (char *)args[5].value,
+                          (component_t)args[4].value, result_out);
 }
 
-/* <production> ::= <nonterminal> DERIVES <exp-list> <reduction> */
-static void *
-make_production(parser_t self)
+/* Gives the terminals in the list the next precedence level */
+static int
+declare_precedence(parser_t self, tpc_list_t *terminals,
+                   associativity_t associativity)
 {
-    production_t production;
+    char *file = self->filename == NULL ? "<stdin>" : self->filename;
+    associativity_t ignored;
+    size_t index;
 
-    production = production_alloc(self->production_count,
-                                  (component_t)self->value_top[0],
-                                  self->component_count,
-                                  self->components,
-                                  (char *)self->value_top[4]);
+    self->precedence_count++;
+    for (index = 0; index < terminals->count; index++) {
+        component_t terminal = (component_t)terminals->values[index];
 
-    self->component_count = 0;
-    self->components = NULL;
-    return production;
+        if (component_get_precedence(terminal, &ignored) != 0) {
+            fprintf(stderr, "%s:%d: precedence of `%s' declared twice\n",
+                    file, self->id_token_line, component_get_name(terminal));
+            tpc_list_free(terminals);
+            return -1;
+        }
+
+        component_set_precedence(terminal, self->precedence_count,
+                                 associativity);
+    }
+
+    tpc_list_free(terminals);
+    return 0;
 }
 
-/* <exp-list> ::= <exp-list> <nonterminal> */
-/* <exp-list> ::= <exp-list> <terminal> */
-static void *
-extend_exp_list(parser_t self)
+/* <declaration> ::= LEFT <terminal>+ */
+static int
+make_left_precedence(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = NULL;
+    return declare_precedence((parser_t)rock, (tpc_list_t *)args[1].value,
+                              ASSOC_LEFT);
+}
+
+/* <declaration> ::= RIGHT <terminal>+ */
+static int
+make_right_precedence(void *rock, tpc_frame_t *args, void **result_out)
 {
-    add_component(self, (component_t)self->value_top[1]);
-    return self->components;
+    *result_out = NULL;
+    return declare_precedence((parser_t)rock, (tpc_list_t *)args[1].value,
+                              ASSOC_RIGHT);
 }
 
-/* <exp-list> ::= <nonterminal> */
-/* <exp-list> ::= <terminal> */
-static void *
-make_exp_list(parser_t self)
+/* <declaration> ::= NONASSOC <terminal>+ */
+static int
+make_nonassoc_precedence(void *rock, tpc_frame_t *args, void **result_out)
 {
-    add_component(self, (component_t)self->value_top[0]);
-    return self->components;
+    *result_out = NULL;
+    return declare_precedence((parser_t)rock, (tpc_list_t *)args[1].value,
+                              ASSOC_NONASSOC);
+}
+
+/* <declaration> ::= START <nonterminal> */
+static int
+make_start(void *rock, tpc_frame_t *args, void **result_out)
+{
+    parser_t self = (parser_t)rock;
+    component_t nonterminal = (component_t)args[1].value;
+    component_t *starts;
+    int i;
+
+    *result_out = NULL;
+
+    /* Each entry point only needs to be declared once */
+    for (i = 0; i < self->start_count; i++) {
+        if (self->starts[i] == nonterminal) {
+            return 0;
+        }
+    }
+
+    starts = (component_t *)realloc(
+        self->starts, (self->start_count + 1) * sizeof(component_t));
+    if (starts == NULL) {
+        return -1;
+    }
+
+    self->starts = starts;
+    self->starts[self->start_count++] = nonterminal;
+    return 0;
+}
+
+/* <exp> ::= <nonterminal> */
+/* <exp> ::= <terminal> */
+static int
+make_exp(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = args[0].value;
+    return 0;
+}
+
+/* <exp> ::= <nonterminal> STAR */
+/* <exp> ::= <terminal> STAR */
+static int
+make_star(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = intern_repetition((parser_t)rock,
+                                    (component_t)args[0].value, '*');
+    return *result_out == NULL ? -1 : 0;
+}
+
+/* <exp> ::= <nonterminal> PLUS */
+/* <exp> ::= <terminal> PLUS */
+static int
+make_plus(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = intern_repetition((parser_t)rock,
+                                    (component_t)args[0].value, '+');
+    return *result_out == NULL ? -1 : 0;
+}
+
+/* <exp> ::= <nonterminal> QUESTION */
+/* <exp> ::= <terminal> QUESTION */
+static int
+make_optional(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = intern_repetition((parser_t)rock,
+                                    (component_t)args[0].value, '?');
+    return *result_out == NULL ? -1 : 0;
 }
 
 /* <nonterminal> ::= LT ID GT */
-static void *
-make_nonterminal(parser_t self)
+static int
+make_nonterminal(void *rock, tpc_frame_t *args, void **result_out)
 {
+    parser_t self = (parser_t)rock;
     char *name;
-    component_t nonterminal;
 
-    name = self->value_top[1];
-    nonterminal = intern_nonterminal(self, name);
+    name = args[1].value;
+    *result_out = intern_nonterminal(self, name);
     free(name);
-    return nonterminal;
+    return 0;
 }
 
 /* <terminal> ::= ID */
-static void *
-make_terminal(parser_t self)
+static int
+make_terminal(void *rock, tpc_frame_t *args, void **result_out)
 {
+    parser_t self = (parser_t)rock;
     char *name;
-    component_t terminal;
 
-    name = self->value_top[0];
-    terminal = intern_terminal(self, name);
+    name = args[0].value;
+    *result_out = intern_terminal(self, name);
     free(name);
-    return terminal;
+    return 0;
 }
 
 /* <reduction> ::= LBRACKET ID RBRACKET */
-static void *
-make_reduction(parser_t self)
+static int
+make_reduction(void *rock, tpc_frame_t *args, void **result_out)
 {
-    return self->value_top[1];
+    *result_out = args[1].value;
+    return 0;
 }
 
 
@@ -805,26 +1220,13 @@ parser_alloc(parser_callback_t callback, void *rock)
     self->line = 1;
     self->lex_state = lex_start;
 
-    /* Allocate some space for the state stack */
-    if ((self->state_stack = (int *)calloc(INITIAL_STACK_SIZE,
-                                           sizeof(int))) == NULL) {
-	parser_free(self);
-	return NULL;
-    }
-
-    /* Allocate space for the value stack */
-    if ((self->value_stack = (void **)calloc(INITIAL_STACK_SIZE,
-                                             sizeof(void *))) == NULL) {
+    /* Create the runtime parser which drives the tables */
+    if ((self->driver = tpc_parser_alloc(&tpc_tables, INITIAL_STACK_SIZE,
+                                         self)) == NULL) {
 	parser_free(self);
 	return NULL;
     }
 
-    /* Set up the stack pointers */
-    self->state_end = self->state_stack + INITIAL_STACK_SIZE;
-    self->state_top = self->state_stack;
-    *(self->state_top) = 0;
-    self->value_top = self->value_stack;
-
     /* Allocate some room for the token buffer */
     if ((self->token = (char *)malloc(INITIAL_BUFFER_SIZE)) == NULL) {
 	parser_free(self);
@@ -849,12 +1251,8 @@ parser_free(parser_t self)
 {
     int index;
 
-    if (self->state_stack != NULL) {
-	free(self->state_stack);
-    }
-
-    if (self->value_stack != NULL) {
-	free(self->value_stack);
+    if (self->driver != NULL) {
+	tpc_parser_free(self->driver);
     }
 
     if (self->token != NULL) {
@@ -877,8 +1275,12 @@ parser_free(parser_t self)
 	free(self->nonterminals);
     }
 
-    if (self->components) {
-	free(self->components);
+    if (self->repetitions != NULL) {
+	free(self->repetitions);
+    }
+
+    if (self->starts != NULL) {
+	free(self->starts);
     }
 
     if (self->productions != NULL) {
@@ -49,11 +49,41 @@ enum format
     FORMAT_C,
 
     /* Generate Python tables */
-    FORMAT_PYTHON
+    FORMAT_PYTHON,
+
+    /* Generate a binary table file */
+    FORMAT_BINARY,
+
+    /* Generate a C++ header */
+    FORMAT_CXX
 };
 
 typedef enum format format_t;
 
+/* The supported kinds of output */
+enum emit
+{
+    /* Emit the parse tables */
+    EMIT_TABLES,
+
+    /* Emit a direct-coded parser */
+    EMIT_CODE,
+
+    /* Emit the parse tables for the tpc runtime */
+    EMIT_RUNTIME,
+
+    /* Emit the parse tables as flat arrays (python only) */
+    EMIT_COMPACT,
+
+    /* Emit the parse tables and a specialized parser (python only) */
+    EMIT_DRIVER,
+
+    /* Emit the runtime tables with a switch which calls the reductions */
+    EMIT_SWITCH
+};
+
+typedef enum emit emit_t;
+
 
 /* The type of the parser callback */
 typedef void (*parser_callback_t)(void *arg, grammar_t grammar);
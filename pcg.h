@@ -1,16 +1,20 @@
-#define IS_ERROR(action) ((action) == 0)
-#define IS_ACCEPT(action) ((action) == 30)
-#define IS_REDUCE(action) (0 < (action) && (action) < 11)
-#define IS_SHIFT(action) (11 <= (action) && (action) < 30)
-#define REDUCTION(action) (action)
-#define REDUCE_GOTO(state, production) \
-    (goto_table[state][production -> nonterm_type])
-#define SHIFT_GOTO(action) ((action) - 11)
+/* Generated by tpc version 0.6.3 */
+
+#include <stdint.h>
+#include "tpc_runtime.h"
 
 typedef enum
 {
     TT_EOF = 0,
     TT_DERIVES,
+    TT_PREC,
+    TT_LEFT,
+    TT_RIGHT,
+    TT_NONASSOC,
+    TT_START,
+    TT_STAR,
+    TT_PLUS,
+    TT_QUESTION,
     TT_LT,
     TT_ID,
     TT_GT,
@@ -18,101 +22,282 @@ typedef enum
     TT_RBRACKET
 } terminal_t;
 
-struct production
+static const struct tpc_production productions[24] =
 {
-    reduction_t reduction;
-    int nonterm_type;
-    int count;
-};
-
-static struct production productions[11] =
-{
-    /* 0: <grammar> ::= <production-list> */
+    /* 0: <grammar> ::= <declaration+> */
     { accept_grammar, 0, 1 },
 
-    /* 1: <production-list> ::= <production-list> <production> */
-    { extend_production_list, 1, 2 },
+    /* 1: <declaration> ::= <nonterminal> DERIVES <exp*> <reduction> */
+    { make_production, 1, 4 },
+
+    /* 2: <declaration> ::= <nonterminal> DERIVES <exp*> PREC <terminal> <reduction> */
+    { make_prec_production, 1, 6 },
+
+    /* 3: <declaration> ::= LEFT <terminal+> */
+    { make_left_precedence, 1, 2 },
+
+    /* 4: <declaration> ::= RIGHT <terminal+> */
+    { make_right_precedence, 1, 2 },
+
+    /* 5: <declaration> ::= NONASSOC <terminal+> */
+    { make_nonassoc_precedence, 1, 2 },
+
+    /* 6: <declaration> ::= START <nonterminal> */
+    { make_start, 1, 2 },
+
+    /* 7: <exp> ::= <nonterminal> */
+    { make_exp, 4, 1 },
 
-    /* 2: <production-list> ::= <production> */
-    { make_production_list, 1, 1 },
+    /* 8: <exp> ::= <terminal> */
+    { make_exp, 4, 1 },
 
-    /* 3: <production> ::= <nonterminal> DERIVES <exp-list> <reduction> */
-    { make_production, 2, 4 },
+    /* 9: <exp> ::= <nonterminal> STAR */
+    { make_star, 4, 2 },
 
-    /* 4: <exp-list> ::= <exp-list> <nonterminal> */
-    { extend_exp_list, 4, 2 },
+    /* 10: <exp> ::= <terminal> STAR */
+    { make_star, 4, 2 },
 
-    /* 5: <exp-list> ::= <exp-list> <terminal> */
-    { extend_exp_list, 4, 2 },
+    /* 11: <exp> ::= <nonterminal> PLUS */
+    { make_plus, 4, 2 },
 
-    /* 6: <exp-list> ::= <nonterminal> */
-    { make_exp_list, 4, 1 },
+    /* 12: <exp> ::= <terminal> PLUS */
+    { make_plus, 4, 2 },
 
-    /* 7: <exp-list> ::= <terminal> */
-    { make_exp_list, 4, 1 },
+    /* 13: <exp> ::= <nonterminal> QUESTION */
+    { make_optional, 4, 2 },
 
-    /* 8: <nonterminal> ::= LT ID GT */
+    /* 14: <exp> ::= <terminal> QUESTION */
+    { make_optional, 4, 2 },
+
+    /* 15: <nonterminal> ::= LT ID GT */
     { make_nonterminal, 3, 3 },
 
-    /* 9: <terminal> ::= ID */
-    { make_terminal, 6, 1 },
+    /* 16: <terminal> ::= ID */
+    { make_terminal, 7, 1 },
+
+    /* 17: <reduction> ::= LBRACKET ID RBRACKET */
+    { make_reduction, 6, 3 },
+
+    /* 18: <declaration+> ::= <declaration> */
+    { tpc_list_one, 2, 1 },
+
+    /* 19: <declaration+> ::= <declaration+> <declaration> */
+    { tpc_list_append, 2, 2 },
+
+    /* 20: <exp*> ::= */
+    { tpc_list_empty, 5, 0 },
 
-    /* 10: <reduction> ::= LBRACKET ID RBRACKET */
-    { make_reduction, 5, 3 }
+    /* 21: <exp*> ::= <exp*> <exp> */
+    { tpc_list_append, 5, 2 },
+
+    /* 22: <terminal+> ::= <terminal> */
+    { tpc_list_one, 8, 1 },
+
+    /* 23: <terminal+> ::= <terminal+> <terminal> */
+    { tpc_list_append, 8, 2 }
 };
 
+typedef uint8_t tpc_action_t;
+
 #define ERR 0
-#define ACC 30
-#define R(x) (x)
-#define S(x) (x + 11)
+#define ACC 3
+#define R(x) (((x) << 2) | 2)
+#define S(x) (((x) << 2) | 1)
 
-static unsigned int sr_table[19][7] =
+static const tpc_action_t sr_table[37][15] =
 {
-    { ERR, ERR, S(4), ERR, ERR, ERR, ERR },
-    { ACC, ERR, S(4), ERR, ERR, ERR, ERR },
-    { R(2), ERR, R(2), ERR, ERR, ERR, ERR },
-    { ERR, S(6), ERR, ERR, ERR, ERR, ERR },
-    { ERR, ERR, ERR, S(7), ERR, ERR, ERR },
-    { R(1), ERR, R(1), ERR, ERR, ERR, ERR },
-    { ERR, ERR, S(4), S(11), ERR, ERR, ERR },
-    { ERR, ERR, ERR, ERR, S(12), ERR, ERR },
-    { ERR, ERR, R(6), R(6), ERR, R(6), ERR },
-    { ERR, ERR, S(4), S(11), ERR, S(16), ERR },
-    { ERR, ERR, R(7), R(7), ERR, R(7), ERR },
-    { ERR, ERR, R(9), R(9), ERR, R(9), ERR },
-    { ERR, R(8), R(8), R(8), ERR, R(8), ERR },
-    { ERR, ERR, R(4), R(4), ERR, R(4), ERR },
-    { R(3), ERR, R(3), ERR, ERR, ERR, ERR },
-    { ERR, ERR, R(5), R(5), ERR, R(5), ERR },
-    { ERR, ERR, ERR, S(17), ERR, ERR, ERR },
-    { ERR, ERR, ERR, ERR, ERR, ERR, S(18) },
-    { R(10), ERR, R(10), ERR, ERR, ERR, ERR }
+    { ERR, ERR, ERR, S(4), S(5), S(6), S(7), ERR, ERR, ERR, S(8), ERR, ERR, ERR, ERR },
+    { R(18), ERR, ERR, R(18), R(18), R(18), R(18), ERR, ERR, ERR, R(18), ERR, ERR, ERR, ERR },
+    { ACC, ERR, ERR, S(4), S(5), S(6), S(7), ERR, ERR, ERR, S(8), ERR, ERR, ERR, ERR },
+    { ERR, S(10), ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(13), ERR, ERR, ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(13), ERR, ERR, ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(13), ERR, ERR, ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(8), ERR, ERR, ERR, ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(17), ERR, ERR, ERR },
+    { R(19), ERR, ERR, R(19), R(19), R(19), R(19), ERR, ERR, ERR, R(19), ERR, ERR, ERR, ERR },
+    { ERR, ERR, R(20), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(20), R(20), ERR, R(20), ERR },
+    { R(22), ERR, ERR, R(22), R(22), R(22), R(22), ERR, ERR, ERR, R(22), R(22), ERR, ERR, ERR },
+    { R(3), ERR, ERR, R(3), R(3), R(3), R(3), ERR, ERR, ERR, R(3), S(13), ERR, ERR, ERR },
+    { R(16), ERR, R(16), R(16), R(16), R(16), R(16), R(16), R(16), R(16), R(16), R(16), ERR, R(16), ERR },
+    { R(4), ERR, ERR, R(4), R(4), R(4), R(4), ERR, ERR, ERR, R(4), S(13), ERR, ERR, ERR },
+    { R(5), ERR, ERR, R(5), R(5), R(5), R(5), ERR, ERR, ERR, R(5), S(13), ERR, ERR, ERR },
+    { R(6), ERR, ERR, R(6), R(6), R(6), R(6), ERR, ERR, ERR, R(6), ERR, ERR, ERR, ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(20), ERR, ERR },
+    { ERR, ERR, S(25), ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(8), S(13), ERR, S(26), ERR },
+    { R(23), ERR, ERR, R(23), R(23), R(23), R(23), ERR, ERR, ERR, R(23), R(23), ERR, ERR, ERR },
+    { R(15), R(15), R(15), R(15), R(15), R(15), R(15), R(15), R(15), R(15), R(15), R(15), ERR, R(15), ERR },
+    { ERR, ERR, R(7), ERR, ERR, ERR, ERR, S(27), S(28), S(29), R(7), R(7), ERR, R(7), ERR },
+    { ERR, ERR, R(21), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(21), R(21), ERR, R(21), ERR },
+    { R(1), ERR, ERR, R(1), R(1), R(1), R(1), ERR, ERR, ERR, R(1), ERR, ERR, ERR, ERR },
+    { ERR, ERR, R(8), ERR, ERR, ERR, ERR, S(30), S(31), S(32), R(8), R(8), ERR, R(8), ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(13), ERR, ERR, ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(34), ERR, ERR, ERR },
+    { ERR, ERR, R(9), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(9), R(9), ERR, R(9), ERR },
+    { ERR, ERR, R(11), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(11), R(11), ERR, R(11), ERR },
+    { ERR, ERR, R(13), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(13), R(13), ERR, R(13), ERR },
+    { ERR, ERR, R(10), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(10), R(10), ERR, R(10), ERR },
+    { ERR, ERR, R(12), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(12), R(12), ERR, R(12), ERR },
+    { ERR, ERR, R(14), ERR, ERR, ERR, ERR, ERR, ERR, ERR, R(14), R(14), ERR, R(14), ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(26), ERR },
+    { ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, ERR, S(36) },
+    { R(2), ERR, ERR, R(2), R(2), R(2), R(2), ERR, ERR, ERR, R(2), ERR, ERR, ERR, ERR },
+    { R(17), ERR, ERR, R(17), R(17), R(17), R(17), ERR, ERR, ERR, R(17), ERR, ERR, ERR, ERR }
 };
 
 #undef ERR
 #undef R
 #undef S
 
-static unsigned int goto_table[19][7] =
+typedef uint8_t tpc_state_t;
+
+static const tpc_state_t goto_table[37][9] =
 {
-    { 0, 1, 2, 3, 0, 0, 0 },
-    { 0, 0, 5, 3, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 8, 9, 0, 10 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 13, 0, 14, 15 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0 }
+    { 0, 1, 2, 3, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 9, 0, 3, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 11, 12 },
+    { 0, 0, 0, 0, 0, 0, 0, 11, 14 },
+    { 0, 0, 0, 0, 0, 0, 0, 11, 15 },
+    { 0, 0, 0, 16, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 18, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 19, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 19, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 19, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 21, 22, 0, 23, 24, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 33, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 35, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0 }
 };
 
+static const char *const terminal_names[15] =
+{
+    "<EOF>",
+    "DERIVES",
+    "PREC",
+    "LEFT",
+    "RIGHT",
+    "NONASSOC",
+    "START",
+    "STAR",
+    "PLUS",
+    "QUESTION",
+    "LT",
+    "ID",
+    "GT",
+    "LBRACKET",
+    "RBRACKET"
+};
+
+static const char *const nonterminal_names[9] =
+{
+    "grammar",
+    "declaration",
+    "declaration+",
+    "nonterminal",
+    "exp",
+    "exp*",
+    "reduction",
+    "terminal",
+    "terminal+"
+};
+
+/* The terminals with an action in each state, as 2-byte
+ * bitsets with terminal t at bit (t & 7) of byte (t >> 3) */
+static const unsigned char expected_sets[26] =
+{
+    0x78, 0x04,
+    0x79, 0x04,
+    0x02, 0x00,
+    0x00, 0x08,
+    0x00, 0x04,
+    0x04, 0x2c,
+    0x79, 0x0c,
+    0xfd, 0x2f,
+    0x00, 0x10,
+    0xff, 0x2f,
+    0x84, 0x2f,
+    0x00, 0x20,
+    0x00, 0x40
+};
+
+typedef uint8_t tpc_expected_t;
+
+static const tpc_expected_t expected_index[37] =
+{
+    0, 1, 1, 2, 3, 3, 3, 4, 3, 1, 5, 6, 6, 7, 6, 6, 1, 8, 5, 6, 9, 10, 5, 1, 10, 3, 3, 5, 5, 5, 5, 5, 5, 11, 12, 1, 1
+};
+
+static const unsigned char kinds[24] =
+{
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_REDUCE,
+    TPC_LIST_ONE,
+    TPC_LIST_APPEND,
+    TPC_LIST_EMPTY,
+    TPC_LIST_APPEND,
+    TPC_LIST_ONE,
+    TPC_LIST_APPEND
+};
+
+static const tpc_tables_t tpc_tables =
+{
+    TPC_ENCODING_TAGGED,
+    sizeof(tpc_action_t),
+    sizeof(tpc_state_t),
+    15, 9, 24, 37,
+    productions,
+    sr_table,
+    goto_table,
+    terminal_names,
+    nonterminal_names,
+    NULL,
+    0,
+    NULL,
+    NULL,
+    sizeof(tpc_expected_t),
+    2,
+    expected_index,
+    expected_sets,
+    kinds,
+    0,
+    NULL
+};
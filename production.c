@@ -43,6 +43,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "sink.h"
 #include "component.h"
 #include "production.h"
 
@@ -62,6 +63,9 @@ struct production
 
     /* The production's reduction */
     char *reduction;
+
+    /* The terminal whose precedence was given to the production */
+    component_t precedence;
 };
 
 /* Allocates and initializes a new production_t */
@@ -85,6 +89,7 @@ production_alloc(int index,
     self->count = component_count;
     self->components = components;
     self->reduction = reduction;
+    self->precedence = NULL;
     return self;
 }
 
@@ -106,6 +111,13 @@ production_get_index(production_t self)
     return self->index;
 }
 
+/* Sets the production's index */
+void
+production_set_index(production_t self, int index)
+{
+    self->index = index;
+}
+
 /* Returns the nonterminal index of the production's left-hand side */
 int
 production_get_nonterminal_index(production_t self)
@@ -113,6 +125,20 @@ production_get_nonterminal_index(production_t self)
     return component_get_index(self->nonterminal);
 }
 
+/* Returns the number of components on the production's right-hand-side */
+int
+production_get_count(production_t self)
+{
+    return self->count;
+}
+
+/* Returns the name of the production's reduction */
+char *
+production_get_reduction(production_t self)
+{
+    return self->reduction;
+}
+
 /* Returns the nth component of the production's right-hand-side */
 component_t
 production_get_component(production_t self, int index)
@@ -124,16 +150,43 @@ production_get_component(production_t self, int index)
     return NULL;
 }
 
+/* Gives the production the precedence of the terminal */
+void
+production_set_precedence(production_t self, component_t terminal)
+{
+    self->precedence = terminal;
+}
+
+/* Returns the terminal whose precedence the production has */
+component_t
+production_get_precedence(production_t self)
+{
+    int index;
+
+    if (self->precedence != NULL) {
+        return self->precedence;
+    }
+
+    /* Otherwise look for the last terminal */
+    for (index = self->count - 1; index >= 0; index--) {
+        if (! component_is_nonterminal(self->components[index])) {
+            return self->components[index];
+        }
+    }
+
+    return NULL;
+}
+
 /* Pretty-prints the receiver */
 void
-production_print(production_t self, FILE *out)
+production_print(production_t self, sink_t out)
 {
     production_print_with_offset(self, out, -1);
 }
 
 /* Pretty-prints the receiver with a `*' after the nth element */
 void
-production_print_with_offset(production_t self, FILE *out, int offset)
+production_print_with_offset(production_t self, sink_t out, int offset)
 {
     int index;
 
@@ -141,12 +194,12 @@ production_print_with_offset(production_t self, FILE *out, int offset)
     component_print(self->nonterminal, out);
 
     /* Print the `derives' operator */
-    fprintf(out, "::= ");
+    sink_puts(out, "::= ");
 
     /* Print the right-hand-side */
     for (index = 0; index < self->count; index++) {
         if (index == offset) {
-            fprintf(out, "* ");
+            sink_puts(out, "* ");
         }
 
         component_print(self->components[index], out);
@@ -154,34 +207,34 @@ production_print_with_offset(production_t self, FILE *out, int offset)
 
     /* Watch for a final `*' */
     if (self->count == offset) {
-        fprintf(out, "* ");
+        sink_puts(out, "* ");
     }
 }
 
 /* Prints the production as a struct */
 void
-production_print_c_struct(production_t self, FILE *out)
+production_print_c_struct(production_t self, sink_t out)
 {
-    fprintf(out, "    { %s, %d, %d }",
-            self->reduction,
-            component_get_index(self->nonterminal),
-            self->count);
+    sink_printf(out, "    { %s, %d, %d }",
+                self->reduction,
+                component_get_index(self->nonterminal),
+                self->count);
 }
 
 /* Prints the production as a python tuple */
 void
-production_print_python_tuple(production_t self, char *module, FILE *out)
+production_print_python_tuple(production_t self, char *module, sink_t out)
 {
     if (module == NULL) {
-        fprintf(out, "    (%s, %d, %d)",
-                self->reduction,
-                component_get_index(self->nonterminal),
-                self->count);
+        sink_printf(out, "    (%s, %d, %d)",
+                    self->reduction,
+                    component_get_index(self->nonterminal),
+                    self->count);
     } else {
-        fprintf(out, "    (%s.%s, %d, %d)",
-                module,
-                self->reduction,
-                component_get_index(self->nonterminal),
-                self->count);
+        sink_printf(out, "    (%s.%s, %d, %d)",
+                    module,
+                    self->reduction,
+                    component_get_index(self->nonterminal),
+                    self->count);
     }
 }
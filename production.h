@@ -60,19 +60,38 @@ int production_get_nonterminal_index(production_t self);
 /* Returns the production's index */
 int production_get_index(production_t self);
 
+/* Sets the production's index */
+void production_set_index(production_t self, int index);
+
+/* Returns the number of components on the production's right-hand-side */
+int production_get_count(production_t self);
+
+/* Returns the name of the production's reduction */
+char *production_get_reduction(production_t self);
+
 /* Returns the nth component of the production's right-hand-side */
 component_t production_get_component(production_t self, int index);
 
+/* Gives the production the precedence of the terminal rather than
+ * that of its last terminal */
+void production_set_precedence(production_t self, component_t terminal);
+
+/* Returns the terminal whose precedence the production has: the one
+ * given to production_set_precedence() if any, otherwise the last
+ * terminal on its right-hand side, or NULL if it has none */
+component_t production_get_precedence(production_t self);
+
 /* Pretty-prints the receiver */
-void production_print(production_t self, FILE *out);
+void production_print(production_t self, sink_t out);
 
 /* Pretty-prints the receiver with a `*' after the nth element */
-void production_print_with_offset(production_t self, FILE *out, int offset);
+void production_print_with_offset(production_t self, sink_t out, int offset);
 
 /* Prints the production as a C struct */
-void production_print_c_struct(production_t self, FILE *out);
+void production_print_c_struct(production_t self, sink_t out);
 
 /* Prints the production as a python tuple */
-void production_print_python_tuple(production_t self, char *module, FILE *out);
+void production_print_python_tuple(production_t self, char *module,
+                                   sink_t out);
 
 #endif /* PRODUCTION_H */
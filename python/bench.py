@@ -0,0 +1,105 @@
+# Compares the tpc_runtime extension with a pure-python parse loop on
+# the tables for e4.pcg.  Build the extension and the tables first:
+#
+#     python3 setup.py build_ext --inplace
+#     tpc --python=tpc_bench_reductions ../e4.pcg > e4_tables.py
+#     python3 bench.py e4_tables.py
+#
+# Tables written with --emit=compact work too.
+
+import sys, time, types, importlib.util
+import tpc_runtime
+
+# Every reduction just counts its arguments
+def reduction(rock, *args):
+    return len(args)
+
+reductions = types.ModuleType('tpc_bench_reductions')
+reductions.__getattr__ = lambda name: reduction
+sys.modules['tpc_bench_reductions'] = reductions
+
+# Load the tables
+spec = importlib.util.spec_from_file_location('tables', sys.argv[1])
+tables = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(tables)
+
+
+class PythonParser:
+    """The obvious pure-python loop over the --python tables"""
+
+    def __init__(self, tables, rock = None):
+        self.productions = tables.productions
+        self.rock = rock
+        if hasattr(tables, 'SR_STRIDE'):
+            stride = tables.SR_STRIDE
+            self.sr_table = [tables.sr_table[i:i + stride]
+                             for i in range(0, len(tables.sr_table), stride)]
+            stride = tables.GOTO_STRIDE
+            self.goto_table = [tables.goto_table[i:i + stride]
+                               for i in range(0, len(tables.goto_table), stride)]
+        else:
+            self.sr_table = tables.sr_table
+            self.goto_table = tables.goto_table
+        self.shift = len(self.productions)
+        self.states = [0]
+        self.values = [None]
+
+    def feed(self, terminal, value):
+        states = self.states
+        values = self.values
+        while True:
+            action = self.sr_table[states[-1]][terminal]
+            if action >= self.shift:
+                states.append(action - self.shift)
+                values.append(value)
+                return False
+
+            if action < 0:
+                state = states[-1]
+                del states[1:], values[1:]
+                raise SyntaxError((state, terminal))
+
+            reduction, nonterm_type, count = self.productions[action]
+            args = values[len(values) - count:]
+            del states[len(states) - count:], values[len(values) - count:]
+            result = reduction(self.rock, *args)
+            if action == 0:
+                return (True, result)
+
+            states.append(self.goto_table[states[-1]][nonterm_type])
+            values.append(result)
+
+
+T = tables
+sentence = [T.TT_ID, T.TT_EQ, T.TT_STRING, T.TT_AND, T.TT_LPAREN, T.TT_ID,
+            T.TT_LT, T.TT_INT32, T.TT_OR, T.TT_ID, T.TT_GE, T.TT_ID,
+            T.TT_TIMES, T.TT_INT32, T.TT_PLUS, T.TT_INT32, T.TT_RPAREN,
+            T.TT_AND, T.TT_BANG, T.TT_ID, T.TT_LPAREN, T.TT_ID, T.TT_RPAREN,
+            T.TT_EOF]
+tokens = [(terminal, None) for terminal in sentence] * 2000
+
+def run(name, parse):
+    best = None
+    for i in range(5):
+        start = time.perf_counter()
+        accepts = parse()
+        elapsed = time.perf_counter() - start
+        if best is None or elapsed < best:
+            best = elapsed
+    assert accepts == 2000, accepts
+    print('%-24s %7.1f ns/token' % (name, best * 1e9 / len(tokens)))
+
+def python_feed():
+    parser = PythonParser(tables)
+    return sum(1 for terminal, value in tokens if parser.feed(terminal, value))
+
+def native_feed():
+    parser = tpc_runtime.Parser(tables)
+    return sum(1 for terminal, value in tokens if parser.feed(terminal, value))
+
+def native_feed_tokens():
+    return len(tpc_runtime.Parser(tables).feed_tokens(tokens))
+
+run('python feed', python_feed)
+run('tpc_runtime feed', native_feed)
+run('tpc_runtime feed_tokens', native_feed_tokens)
@@ -0,0 +1,10 @@
+# Builds the tpc_runtime extension module against the local python:
+#
+#     python3 setup.py build_ext --inplace
+
+from setuptools import setup, Extension
+
+setup(name = 'tpc_runtime',
+      version = '0.6.3',
+      description = 'A native driver for the parse tables written by tpc',
+      ext_modules = [Extension('tpc_runtime', ['tpcmodule.c'])])
@@ -0,0 +1,798 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/*
+ * A CPython extension which drives the tables written by `tpc
+ * --python'.  The shift/reduce loop runs in C and only calls back
+ * into python to perform reductions.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+/* The initial number of frames on a parser's stack */
+#define INITIAL_STACK_SIZE 32
+
+/* The actions which aren't shifts or reductions */
+#define ERR_ACTION -1
+#define ACC_ACTION 0
+
+/* Raised when a token can't be shifted or reduced */
+static PyObject *ParseError;
+
+/* The parser data structure */
+typedef struct
+{
+    PyObject_HEAD
+
+    /* The number of terminal symbols */
+    int terminal_count;
+
+    /* The number of nonterminal symbols */
+    int nonterminal_count;
+
+    /* The number of productions, which is also the first shift action */
+    int production_count;
+
+    /* The number of kernels (states) */
+    int kernel_count;
+
+    /* The shift/reduce table, indexed by state and terminal */
+    int *sr_table;
+
+    /* The goto table, indexed by state and nonterminal */
+    int *goto_table;
+
+    /* The reduction function of each production */
+    PyObject **reductions;
+
+    /* The nonterminal to which each production reduces */
+    int *nonterm_types;
+
+    /* The number of components of each production */
+    int *counts;
+
+    /* The first argument handed to each reduction */
+    PyObject *rock;
+
+    /* The state stack */
+    int *states;
+
+    /* The value stack */
+    PyObject **values;
+
+    /* The index of the top of the stacks */
+    Py_ssize_t top;
+
+    /* The number of frames the stacks can hold */
+    Py_ssize_t capacity;
+} ParserObject;
+
+
+/* Copies a table of integers into a new C array.  Tables written with
+ * --emit=compact are flat sequences with the given stride, while the
+ * others are sequences of rows. */
+static int *
+read_table(PyObject *table,
+           PyObject *stride,
+           const char *what,
+           int *row_count_out,
+           int *column_count_out)
+{
+    PyObject *rows;
+    int *result = NULL;
+    Py_ssize_t row_count, column_count;
+    Py_ssize_t i, j;
+
+    if ((rows = PySequence_Fast(table, what)) == NULL) {
+        return NULL;
+    }
+
+    /* Work out the table's dimensions */
+    if (stride != NULL) {
+        column_count = PyLong_AsSsize_t(stride);
+        if (column_count <= 0) {
+            if (! PyErr_Occurred()) {
+                PyErr_Format(PyExc_ValueError, "bad stride for %s", what);
+            }
+            goto fail;
+        }
+
+        row_count = PySequence_Fast_GET_SIZE(rows) / column_count;
+        if (PySequence_Fast_GET_SIZE(rows) % column_count != 0) {
+            row_count = 0;
+        }
+    } else {
+        row_count = PySequence_Fast_GET_SIZE(rows);
+        column_count = row_count == 0 ? 0 :
+            PyObject_Length(PySequence_Fast_GET_ITEM(rows, 0));
+        if (column_count < 0) {
+            goto fail;
+        }
+    }
+
+    if (row_count == 0 || column_count == 0 ||
+        row_count > INT_MAX / column_count) {
+        PyErr_Format(PyExc_ValueError, "bad dimensions for %s", what);
+        goto fail;
+    }
+
+    result = (int *)PyMem_Malloc(row_count * column_count * sizeof(int));
+    if (result == NULL) {
+        PyErr_NoMemory();
+        goto fail;
+    }
+
+    /* Copy each entry */
+    for (i = 0; i < row_count; i++) {
+        PyObject *row = NULL;
+
+        if (stride == NULL) {
+            row = PySequence_Fast(PySequence_Fast_GET_ITEM(rows, i), what);
+            if (row == NULL) {
+                goto fail;
+            }
+
+            if (PySequence_Fast_GET_SIZE(row) != column_count) {
+                PyErr_Format(PyExc_ValueError, "ragged %s", what);
+                Py_DECREF(row);
+                goto fail;
+            }
+        }
+
+        for (j = 0; j < column_count; j++) {
+            PyObject *item = row != NULL ?
+                PySequence_Fast_GET_ITEM(row, j) :
+                PySequence_Fast_GET_ITEM(rows, i * column_count + j);
+            long value = PyLong_AsLong(item);
+
+            if (value == -1 && PyErr_Occurred()) {
+                Py_XDECREF(row);
+                goto fail;
+            }
+
+            if (value < INT_MIN || INT_MAX < value) {
+                PyErr_Format(PyExc_ValueError, "bad entry in %s", what);
+                Py_XDECREF(row);
+                goto fail;
+            }
+
+            result[i * column_count + j] = (int)value;
+        }
+
+        Py_XDECREF(row);
+    }
+
+    Py_DECREF(rows);
+    *row_count_out = (int)row_count;
+    *column_count_out = (int)column_count;
+    return result;
+
+fail:
+    PyMem_Free(result);
+    Py_DECREF(rows);
+    return NULL;
+}
+
+/* Reads the productions table, a sequence of (reduction,
+ * nonterm_type, count) tuples */
+static int
+read_productions(ParserObject *self, PyObject *table)
+{
+    PyObject *productions;
+    Py_ssize_t count;
+    Py_ssize_t i;
+
+    if ((productions = PySequence_Fast(table, "productions")) == NULL) {
+        return -1;
+    }
+
+    count = PySequence_Fast_GET_SIZE(productions);
+    if (count == 0 || count > INT_MAX / 2) {
+        PyErr_SetString(PyExc_ValueError, "bad productions");
+        Py_DECREF(productions);
+        return -1;
+    }
+
+    self->production_count = (int)count;
+    self->reductions = (PyObject **)PyMem_Calloc(count, sizeof(PyObject *));
+    self->nonterm_types = (int *)PyMem_Malloc(count * sizeof(int));
+    self->counts = (int *)PyMem_Malloc(count * sizeof(int));
+    if (self->reductions == NULL || self->nonterm_types == NULL ||
+        self->counts == NULL) {
+        PyErr_NoMemory();
+        Py_DECREF(productions);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        PyObject *reduction;
+
+        if (! PyArg_ParseTuple(PySequence_Fast_GET_ITEM(productions, i),
+                               "Oii;productions must hold "
+                               "(reduction, nonterm_type, count) tuples",
+                               &reduction,
+                               &self->nonterm_types[i],
+                               &self->counts[i])) {
+            Py_DECREF(productions);
+            return -1;
+        }
+
+        if (! PyCallable_Check(reduction)) {
+            PyErr_Format(PyExc_TypeError,
+                         "reduction for production %zd is not callable", i);
+            Py_DECREF(productions);
+            return -1;
+        }
+
+        Py_INCREF(reduction);
+        self->reductions[i] = reduction;
+    }
+
+    Py_DECREF(productions);
+    return 0;
+}
+
+/* Makes sure that every entry of the tables is in range so that the
+ * parse loop needn't check */
+static int
+check_tables(ParserObject *self)
+{
+    int i;
+
+    for (i = 0; i < self->production_count; i++) {
+        if (! (0 <= self->nonterm_types[i] &&
+               self->nonterm_types[i] < self->nonterminal_count &&
+               0 <= self->counts[i])) {
+            PyErr_Format(PyExc_ValueError, "bad production %d", i);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < self->kernel_count * self->terminal_count; i++) {
+        int action = self->sr_table[i];
+
+        if (! (ERR_ACTION <= action &&
+               action < self->production_count + self->kernel_count)) {
+            PyErr_Format(PyExc_ValueError, "bad action %d", action);
+            return -1;
+        }
+    }
+
+    for (i = 0; i < self->kernel_count * self->nonterminal_count; i++) {
+        if (! (0 <= self->goto_table[i] &&
+               self->goto_table[i] < self->kernel_count)) {
+            PyErr_Format(PyExc_ValueError, "bad goto %d", self->goto_table[i]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Discards the values on the stack and starts afresh */
+static void
+parser_reset(ParserObject *self)
+{
+    while (self->top > 0) {
+        Py_CLEAR(self->values[self->top]);
+        self->top--;
+    }
+
+    self->states[0] = 0;
+}
+
+/* Pushes a state and value onto the stack, stealing the reference to
+ * the value.  Returns 0 on success, -1 on failure */
+static int
+push(ParserObject *self, int state, PyObject *value)
+{
+    /* Grow the stack if it's full */
+    if (self->top + 1 == self->capacity) {
+        Py_ssize_t capacity = self->capacity * 2;
+        int *states;
+        PyObject **values;
+
+        states = (int *)PyMem_Realloc(self->states, capacity * sizeof(int));
+        if (states == NULL) {
+            Py_DECREF(value);
+            PyErr_NoMemory();
+            return -1;
+        }
+
+        self->states = states;
+        values = (PyObject **)PyMem_Realloc(self->values,
+                                            capacity * sizeof(PyObject *));
+        if (values == NULL) {
+            Py_DECREF(value);
+            PyErr_NoMemory();
+            return -1;
+        }
+
+        self->values = values;
+        self->capacity = capacity;
+    }
+
+    self->top++;
+    self->states[self->top] = state;
+    self->values[self->top] = value;
+    return 0;
+}
+
+/* Pops the components of a production off the stack and calls its
+ * reduction with the rock and their values */
+static PyObject *
+reduce(ParserObject *self, int production)
+{
+    int count = self->counts[production];
+    PyObject *args;
+    PyObject *result;
+    int i;
+
+    if (count > self->top) {
+        PyErr_SetString(PyExc_RuntimeError, "parser stack underflow");
+        return NULL;
+    }
+
+    if ((args = PyTuple_New(count + 1)) == NULL) {
+        return NULL;
+    }
+
+    Py_INCREF(self->rock);
+    PyTuple_SET_ITEM(args, 0, self->rock);
+
+    /* Hand the stack's references over to the arguments */
+    self->top -= count;
+    for (i = 1; i <= count; i++) {
+        PyTuple_SET_ITEM(args, i, self->values[self->top + i]);
+        self->values[self->top + i] = NULL;
+    }
+
+    result = PyObject_Call(self->reductions[production], args, NULL);
+    Py_DECREF(args);
+    return result;
+}
+
+/* Feeds a token to the parser.  Returns 1 and a new reference to the
+ * result if the token completed a parse, 0 if it was shifted or -1
+ * with an exception set on error, in which case the parser is reset */
+static int
+feed(ParserObject *self, PyObject *terminal, PyObject *value,
+     PyObject **result_out)
+{
+    long type = PyLong_AsLong(terminal);
+    int *sr_row;
+
+    if (type == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+
+    if (! (0 <= type && type < self->terminal_count)) {
+        PyErr_Format(PyExc_ValueError, "unknown terminal %ld", type);
+        return -1;
+    }
+
+    sr_row = self->sr_table + type;
+    while (1) {
+        int state = self->states[self->top];
+        int action = sr_row[state * self->terminal_count];
+        PyObject *result;
+
+        /* Shift */
+        if (self->production_count <= action) {
+            Py_INCREF(value);
+            if (push(self, action - self->production_count, value) < 0) {
+                parser_reset(self);
+                return -1;
+            }
+
+            return 0;
+        }
+
+        /* Reject */
+        if (action == ERR_ACTION) {
+            PyObject *error = Py_BuildValue("(il)", state, type);
+
+            if (error != NULL) {
+                PyErr_SetObject(ParseError, error);
+                Py_DECREF(error);
+            }
+
+            parser_reset(self);
+            return -1;
+        }
+
+        /* Reduce (by the start production to accept) */
+        if ((result = reduce(self, action)) == NULL) {
+            parser_reset(self);
+            return -1;
+        }
+
+        if (action == ACC_ACTION) {
+            parser_reset(self);
+            *result_out = result;
+            return 1;
+        }
+
+        state = self->goto_table[
+            self->states[self->top] * self->nonterminal_count +
+            self->nonterm_types[action]];
+        if (push(self, state, result) < 0) {
+            parser_reset(self);
+            return -1;
+        }
+    }
+}
+
+
+/* Parser.__new__ */
+static PyObject *
+Parser_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
+{
+    return type->tp_alloc(type, 0);
+}
+
+/* Parser.__init__(tables, rock=None) */
+static int
+Parser_init(ParserObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = { "tables", "rock", NULL };
+    PyObject *tables;
+    PyObject *rock = Py_None;
+    PyObject *table;
+    PyObject *stride;
+    int rows;
+
+    if (self->rock != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Parser is already initialized");
+        return -1;
+    }
+
+    if (! PyArg_ParseTupleAndKeywords(args, kwargs, "O|O:Parser", keywords,
+                                      &tables, &rock)) {
+        return -1;
+    }
+
+    Py_INCREF(rock);
+    self->rock = rock;
+
+    /* Read the productions */
+    if ((table = PyObject_GetAttrString(tables, "productions")) == NULL) {
+        return -1;
+    }
+
+    if (read_productions(self, table) < 0) {
+        Py_DECREF(table);
+        return -1;
+    }
+
+    Py_DECREF(table);
+
+    /* Read the shift/reduce table */
+    if ((table = PyObject_GetAttrString(tables, "sr_table")) == NULL) {
+        return -1;
+    }
+
+    stride = PyObject_GetAttrString(tables, "SR_STRIDE");
+    PyErr_Clear();
+    self->sr_table = read_table(table, stride, "sr_table",
+                                &self->kernel_count, &self->terminal_count);
+    Py_XDECREF(stride);
+    Py_DECREF(table);
+    if (self->sr_table == NULL) {
+        return -1;
+    }
+
+    /* Read the goto table */
+    if ((table = PyObject_GetAttrString(tables, "goto_table")) == NULL) {
+        return -1;
+    }
+
+    stride = PyObject_GetAttrString(tables, "GOTO_STRIDE");
+    PyErr_Clear();
+    self->goto_table = read_table(table, stride, "goto_table",
+                                  &rows, &self->nonterminal_count);
+    Py_XDECREF(stride);
+    Py_DECREF(table);
+    if (self->goto_table == NULL) {
+        return -1;
+    }
+
+    if (rows != self->kernel_count) {
+        PyErr_SetString(PyExc_ValueError,
+                        "sr_table and goto_table have different lengths");
+        return -1;
+    }
+
+    if (check_tables(self) < 0) {
+        return -1;
+    }
+
+    /* Allocate the stacks */
+    self->capacity = INITIAL_STACK_SIZE;
+    self->states = (int *)PyMem_Malloc(self->capacity * sizeof(int));
+    self->values = (PyObject **)PyMem_Calloc(self->capacity,
+                                             sizeof(PyObject *));
+    if (self->states == NULL || self->values == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    self->top = 0;
+    self->states[0] = 0;
+    return 0;
+}
+
+/* Releases the resources consumed by the receiver */
+static void
+Parser_dealloc(ParserObject *self)
+{
+    int i;
+
+    if (self->states != NULL) {
+        parser_reset(self);
+    }
+
+    if (self->reductions != NULL) {
+        for (i = 0; i < self->production_count; i++) {
+            Py_XDECREF(self->reductions[i]);
+        }
+    }
+
+    Py_XDECREF(self->rock);
+    PyMem_Free(self->sr_table);
+    PyMem_Free(self->goto_table);
+    PyMem_Free(self->reductions);
+    PyMem_Free(self->nonterm_types);
+    PyMem_Free(self->counts);
+    PyMem_Free(self->states);
+    PyMem_Free(self->values);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/* Makes sure the receiver's __init__ has been called */
+static int
+check_initialized(ParserObject *self)
+{
+    if (self->states == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Parser is not initialized");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Parser.feed(terminal, value) */
+static PyObject *
+Parser_feed(ParserObject *self, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *result = NULL;
+
+    if (nargs != 2) {
+        PyErr_Format(PyExc_TypeError,
+                     "feed() takes exactly 2 arguments (%zd given)", nargs);
+        return NULL;
+    }
+
+    if (check_initialized(self) < 0) {
+        return NULL;
+    }
+
+    switch (feed(self, args[0], args[1], &result)) {
+    case 0:
+        Py_RETURN_FALSE;
+
+    case 1:
+        return Py_BuildValue("(ON)", Py_True, result);
+
+    default:
+        return NULL;
+    }
+}
+
+/* Parser.feed_tokens(tokens) */
+static PyObject *
+Parser_feed_tokens(ParserObject *self, PyObject *tokens)
+{
+    PyObject *iterator;
+    PyObject *results;
+    PyObject *token;
+
+    if (check_initialized(self) < 0) {
+        return NULL;
+    }
+
+    if ((iterator = PyObject_GetIter(tokens)) == NULL) {
+        return NULL;
+    }
+
+    if ((results = PyList_New(0)) == NULL) {
+        Py_DECREF(iterator);
+        return NULL;
+    }
+
+    while ((token = PyIter_Next(iterator)) != NULL) {
+        PyObject *result;
+        int status;
+
+        if (! PyTuple_Check(token) || PyTuple_GET_SIZE(token) != 2) {
+            PyErr_SetString(PyExc_TypeError,
+                            "tokens must be (terminal, value) tuples");
+            Py_DECREF(token);
+            goto fail;
+        }
+
+        status = feed(self, PyTuple_GET_ITEM(token, 0),
+                      PyTuple_GET_ITEM(token, 1), &result);
+        Py_DECREF(token);
+        if (status < 0) {
+            goto fail;
+        }
+
+        if (status == 1) {
+            if (PyList_Append(results, result) < 0) {
+                Py_DECREF(result);
+                goto fail;
+            }
+
+            Py_DECREF(result);
+        }
+    }
+
+    Py_DECREF(iterator);
+    if (PyErr_Occurred()) {
+        Py_DECREF(results);
+        return NULL;
+    }
+
+    return results;
+
+fail:
+    Py_DECREF(iterator);
+    Py_DECREF(results);
+    return NULL;
+}
+
+/* Parser.reset() */
+static PyObject *
+Parser_reset(ParserObject *self, PyObject *ignored)
+{
+    if (check_initialized(self) < 0) {
+        return NULL;
+    }
+
+    parser_reset(self);
+    Py_RETURN_NONE;
+}
+
+/* Parser.state */
+static PyObject *
+Parser_get_state(ParserObject *self, void *closure)
+{
+    if (check_initialized(self) < 0) {
+        return NULL;
+    }
+
+    return PyLong_FromLong(self->states[self->top]);
+}
+
+
+static PyMethodDef Parser_methods[] =
+{
+    { "feed", (PyCFunction)(void (*)(void))Parser_feed, METH_FASTCALL,
+      "feed(terminal, value) -> False or (True, result)\n\n"
+      "Feeds one token to the parser.  Returns (True, result) if it\n"
+      "completed a parse, otherwise False." },
+    { "feed_tokens", (PyCFunction)Parser_feed_tokens, METH_O,
+      "feed_tokens(tokens) -> list\n\n"
+      "Feeds an iterable of (terminal, value) tuples to the parser and\n"
+      "returns the results of the parses they completed." },
+    { "reset", (PyCFunction)Parser_reset, METH_NOARGS,
+      "reset()\n\nDiscards any partial parse." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef Parser_getset[] =
+{
+    { "state", (getter)Parser_get_state, NULL,
+      "The parser's current state", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject ParserType =
+{
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tpc_runtime.Parser",
+    .tp_basicsize = sizeof(ParserObject),
+    .tp_dealloc = (destructor)Parser_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Parser(tables, rock=None)\n\n"
+              "Drives the parse tables of a module written by tpc --python.\n"
+              "Each reduction is called with the rock followed by the values\n"
+              "of its production's components and returns the new value.",
+    .tp_methods = Parser_methods,
+    .tp_getset = Parser_getset,
+    .tp_init = (initproc)Parser_init,
+    .tp_new = Parser_new
+};
+
+static struct PyModuleDef tpc_runtime_module =
+{
+    PyModuleDef_HEAD_INIT,
+    .m_name = "tpc_runtime",
+    .m_doc = "A native driver for the parse tables written by tpc --python.",
+    .m_size = -1
+};
+
+/* Initializes the module */
+PyMODINIT_FUNC
+PyInit_tpc_runtime(void)
+{
+    PyObject *module;
+
+    if (PyType_Ready(&ParserType) < 0) {
+        return NULL;
+    }
+
+    if ((module = PyModule_Create(&tpc_runtime_module)) == NULL) {
+        return NULL;
+    }
+
+    ParseError = PyErr_NewExceptionWithDoc(
+        "tpc_runtime.ParseError",
+        "Raised with (state, terminal) when a token is not expected",
+        NULL, NULL);
+    if (ParseError == NULL ||
+        PyModule_AddObject(module, "ParseError", ParseError) < 0) {
+        Py_XDECREF(ParseError);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    Py_INCREF(ParseError);
+    Py_INCREF(&ParserType);
+    if (PyModule_AddObject(module, "Parser", (PyObject *)&ParserType) < 0) {
+        Py_DECREF(&ParserType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
+}
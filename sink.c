@@ -0,0 +1,206 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sink.h"
+
+/* The number of bytes buffered before they are written out */
+#define SINK_BUFFER_SIZE 65536
+
+struct sink
+{
+    /* The file to which the output is written */
+    FILE *file;
+
+    /* Nonzero if some output could not be written */
+    int error;
+
+    /* The number of bytes in the buffer */
+    size_t length;
+
+    /* The buffered output */
+    char buffer[SINK_BUFFER_SIZE];
+};
+
+
+/* Allocates and initializes a new sink_t which writes to file */
+sink_t
+sink_alloc(FILE *file)
+{
+    sink_t self;
+
+    if ((self = (sink_t)malloc(sizeof(struct sink))) == NULL) {
+        return NULL;
+    }
+
+    self->file = file;
+    self->error = 0;
+    self->length = 0;
+    return self;
+}
+
+/* Flushes the receiver and releases its resources */
+int
+sink_free(sink_t self)
+{
+    int result = sink_flush(self);
+
+    free(self);
+    return result;
+}
+
+/* Writes out the receiver's buffer in a single call */
+int
+sink_flush(sink_t self)
+{
+    if (self->length != 0 &&
+        fwrite(self->buffer, 1, self->length, self->file) != self->length) {
+        self->error = 1;
+    }
+
+    self->length = 0;
+    if (fflush(self->file) != 0) {
+        self->error = 1;
+    }
+
+    return self->error ? -1 : 0;
+}
+
+/* Appends length bytes of data */
+void
+sink_write(sink_t self, const void *data, size_t length)
+{
+    /* Make room in the buffer */
+    if (SINK_BUFFER_SIZE - self->length < length) {
+        sink_flush(self);
+
+        /* Don't bother copying anything which won't fit anyway */
+        if (! (length < SINK_BUFFER_SIZE)) {
+            if (fwrite(data, 1, length, self->file) != length) {
+                self->error = 1;
+            }
+
+            return;
+        }
+    }
+
+    memcpy(self->buffer + self->length, data, length);
+    self->length += length;
+}
+
+/* Appends a string */
+void
+sink_puts(sink_t self, const char *string)
+{
+    sink_write(self, string, strlen(string));
+}
+
+/* Appends a single character */
+void
+sink_putc(sink_t self, int ch)
+{
+    if (self->length == SINK_BUFFER_SIZE) {
+        sink_flush(self);
+    }
+
+    self->buffer[self->length++] = (char)ch;
+}
+
+/* Appends an integer in decimal */
+void
+sink_int(sink_t self, long value)
+{
+    char digits[24];
+    char *point = digits + sizeof(digits);
+    unsigned long number = value < 0 ?
+        0 - (unsigned long)value : (unsigned long)value;
+
+    /* Write the digits out backwards */
+    do {
+        *--point = (char)('0' + number % 10);
+        number /= 10;
+    } while (number != 0);
+
+    if (value < 0) {
+        *--point = '-';
+    }
+
+    sink_write(self, point, digits + sizeof(digits) - point);
+}
+
+/* Appends printf-style formatted output */
+void
+sink_printf(sink_t self, const char *format, ...)
+{
+    size_t room = SINK_BUFFER_SIZE - self->length;
+    va_list args;
+    int length;
+
+    /* Try formatting straight into the buffer */
+    va_start(args, format);
+    length = vsnprintf(self->buffer + self->length, room, format, args);
+    va_end(args);
+
+    if (length < 0) {
+        self->error = 1;
+        return;
+    }
+
+    if ((size_t)length < room) {
+        self->length += length;
+        return;
+    }
+
+    /* Otherwise make room and try again */
+    sink_flush(self);
+    va_start(args, format);
+    if ((size_t)length < SINK_BUFFER_SIZE) {
+        vsnprintf(self->buffer, SINK_BUFFER_SIZE, format, args);
+        self->length = length;
+    } else if (vfprintf(self->file, format, args) < 0) {
+        self->error = 1;
+    }
+    va_end(args);
+}
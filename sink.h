@@ -0,0 +1,72 @@
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+#ifndef SINK_H
+#define SINK_H
+
+/* The sink type, which buffers output on its way to a FILE */
+typedef struct sink *sink_t;
+
+
+/* Allocates and initializes a new sink_t which writes to file */
+sink_t sink_alloc(FILE *file);
+
+/* Flushes the receiver and releases its resources.  Returns 0 on
+ * success, -1 if any of its output could not be written */
+int sink_free(sink_t self);
+
+/* Writes out the receiver's buffer in a single call.  Returns 0 on
+ * success, -1 if any output so far could not be written */
+int sink_flush(sink_t self);
+
+/* Appends length bytes of data */
+void sink_write(sink_t self, const void *data, size_t length);
+
+/* Appends a string */
+void sink_puts(sink_t self, const char *string);
+
+/* Appends a single character */
+void sink_putc(sink_t self, int ch);
+
+/* Appends an integer in decimal */
+void sink_int(sink_t self, long value);
+
+/* Appends printf-style formatted output */
+void sink_printf(sink_t self, const char *format, ...);
+
+#endif /* SINK_H */
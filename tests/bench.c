@@ -0,0 +1,228 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/* Times how fast tables which tpc wrote to the file named by TABLES
+ * parse a sentence of e4.pcg with reductions which do nothing.  If
+ * CODE is defined then they were written with --emit=code and keep
+ * their own stacks, as code.c's do.  Run them with `make bench'. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <time.h>
+#include "tpc_runtime.h"
+
+/* The number of times to parse the sentence in each run */
+#define REPEAT 100000
+
+/* The number of runs, of which the fastest is reported */
+#define RUNS 5
+
+/* The frames on a parser's stack, which never need to grow for the
+ * sentence */
+#define STACK_SIZE 64
+
+#ifdef CODE
+/* The parser's stacks */
+typedef struct parser
+{
+    int states[STACK_SIZE];
+    void *values[STACK_SIZE];
+    int *state_top;
+    void **value_top;
+} *parser_t;
+
+/* Pushes a state and its value */
+static int
+push(parser_t self, int state, void *value)
+{
+    if (! (self->state_top + 1 < self->states + STACK_SIZE)) {
+        return -1;
+    }
+
+    *(++self->state_top) = state;
+    *(self->value_top++) = value;
+    return 0;
+}
+
+/* Pops the components of a production */
+static void
+pop(parser_t self, int count)
+{
+    self->state_top -= count;
+    self->value_top -= count;
+}
+
+/* Returns the top of the state stack */
+static int
+top(parser_t self)
+{
+    return *(self->state_top);
+}
+
+/* Each of e4.pcg's reductions does nothing, but answers something
+ * other than NULL, which would mean it failed */
+#define STUB(name) \
+    void *name(parser_t self) \
+    { \
+        return self; \
+    }
+#else /* CODE */
+#define STUB(name) \
+    int name(void *rock, tpc_frame_t *args, void **result_out) \
+    { \
+        *result_out = NULL; \
+        return 0; \
+    }
+#endif /* CODE */
+
+#include "bench_stubs.h"
+#include TABLES
+
+/* The sentence, which python/bench.py also parses */
+static const terminal_t sentence[] =
+{
+    TT_ID, TT_EQ, TT_STRING, TT_AND, TT_LPAREN, TT_ID, TT_LT, TT_INT32,
+    TT_OR, TT_ID, TT_GE, TT_ID, TT_TIMES, TT_INT32, TT_PLUS, TT_INT32,
+    TT_RPAREN, TT_AND, TT_BANG, TT_ID, TT_LPAREN, TT_ID, TT_RPAREN,
+    TT_EOF
+};
+
+#define SENTENCE_LENGTH (sizeof(sentence) / sizeof(sentence[0]))
+
+#ifdef CODE
+/* Parses the sentence REPEAT times and answers how many times it was
+ * accepted */
+static long
+parse(void)
+{
+    struct parser parser;
+    void *result;
+    long accepts = 0;
+    long i;
+    size_t j;
+
+    for (i = 0; i < REPEAT; i++) {
+        parser.state_top = parser.states;
+        parser.states[0] = 0;
+        parser.value_top = parser.values;
+
+        for (j = 0; j < SENTENCE_LENGTH; j++) {
+            switch (tpc_shift_reduce(&parser, sentence[j], NULL, &result)) {
+            case TPC_OK:
+                break;
+
+            case TPC_ACCEPT:
+                accepts++;
+                break;
+
+            default:
+                return accepts;
+            }
+        }
+    }
+
+    return accepts;
+}
+#else /* CODE */
+/* Parses the sentence REPEAT times and answers how many times it was
+ * accepted */
+static long
+parse(void)
+{
+    tpc_token_t tokens[SENTENCE_LENGTH];
+    tpc_parser_t parser;
+    size_t consumed;
+    void *result;
+    long accepts = 0;
+    long i;
+    size_t j;
+
+    for (j = 0; j < SENTENCE_LENGTH; j++) {
+        tokens[j].terminal = (int)sentence[j];
+        tokens[j].value = NULL;
+    }
+
+    if ((parser = tpc_parser_alloc(&tpc_tables, STACK_SIZE, NULL)) == NULL) {
+        return 0;
+    }
+
+    for (i = 0; i < REPEAT; i++) {
+        if (tpc_parser_feed_tokens(parser, tokens, SENTENCE_LENGTH,
+                                   &consumed, &result) != TPC_ACCEPT ||
+            consumed != SENTENCE_LENGTH) {
+            break;
+        }
+
+        accepts++;
+    }
+
+    tpc_parser_free(parser);
+    return accepts;
+}
+#endif /* CODE */
+
+int
+main(int argc, char *argv[])
+{
+    clock_t best = 0;
+    clock_t start;
+    clock_t elapsed;
+    int run;
+
+    for (run = 0; run < RUNS; run++) {
+        start = clock();
+        if (parse() != REPEAT) {
+            fprintf(stderr, "%s: the sentence wasn't accepted\n", argv[0]);
+            return 1;
+        }
+
+        elapsed = clock() - start;
+        if (run == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    printf("%-24s %7.1f ns/token\n", argv[0],
+           (double)best * 1e9 / CLOCKS_PER_SEC /
+           ((double)REPEAT * SENTENCE_LENGTH));
+    return 0;
+}
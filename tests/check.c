@@ -0,0 +1,480 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "check.h"
+#include "reductions.h"
+
+/* The room for the values of one expression */
+#define POOL_SIZE 4096
+
+/* The expressions and what they should parse to */
+const struct check_case check_cases[] =
+{
+    { "1", "=1" },
+    { "1+2*3", "=(1+(2*3))" },
+    { "1*2+3", "=((1*2)+3)" },
+    { "(1+2)*3", "=([(1+2)]*3)" },
+    { "1-2-3", "=((1-2)-3)" },
+    { "1--2", "=(1--2)" },
+    { "-1*-2", "=(-1*-2)" },
+    { "((((((((7))))))))", "=[[[[[[[[7]]]]]]]]" },
+    { "1+(2-(3*(4+5)))*6", "=(1+([(2-[(3*[(4+5)])])]*6))" },
+    { "", NULL },
+    { "1+", NULL },
+    { "(1", NULL },
+    { "1)", NULL },
+    { "1 2", NULL },
+    { "--1", NULL },
+    { "1*()", NULL },
+    { NULL, NULL }
+};
+
+/* The values of the current expression */
+static char pool[POOL_SIZE];
+static size_t used = 0;
+
+/* The reduction which fails, if any */
+static const char *failing = NULL;
+
+/* The number of times pass has been called */
+int check_pass_count = 0;
+
+/* Splits an expression into tokens */
+int
+check_tokenize(const char *input, const char **names, char **values,
+               int count)
+{
+    const char *point = input;
+    int length = 0;
+
+    while (1) {
+        const char *name;
+        size_t size = 1;
+
+        /* Skip the spaces between tokens */
+        point += strspn(point, " ");
+        switch (*point) {
+        case '\0':
+            name = "<EOF>";
+            size = 0;
+            break;
+
+        case '+':
+            name = "plus";
+            break;
+
+        case '-':
+            name = "minus";
+            break;
+
+        case '*':
+            name = "times";
+            break;
+
+        case '(':
+            name = "lparen";
+            break;
+
+        case ')':
+            name = "rparen";
+            break;
+
+        default:
+            if ((size = strspn(point, "0123456789")) == 0) {
+                return -1;
+            }
+
+            name = "number";
+            break;
+        }
+
+        if (! (length < count)) {
+            return -1;
+        }
+
+        values[length] = check_format("%.*s", (int)size, point);
+        if (values[length] == NULL) {
+            return -1;
+        }
+
+        names[length++] = name;
+        if (size == 0) {
+            return length;
+        }
+
+        point += size;
+    }
+}
+
+/* Formats a value into the pool */
+char *
+check_format(const char *format, ...)
+{
+    char *value = pool + used;
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(value, POOL_SIZE - used, format, args);
+    va_end(args);
+    if (length < 0 || ! ((size_t)length < POOL_SIZE - used)) {
+        return NULL;
+    }
+
+    used += length + 1;
+    return value;
+}
+
+/* Empties the pool */
+void
+check_clear(void)
+{
+    used = 0;
+}
+
+/* Answers the tables' number for the named terminal, or -1 */
+static int
+lookup_terminal(const tpc_tables_t *tables, const char *name)
+{
+    int index;
+
+    for (index = 0; index < tables->terminal_count; index++) {
+        if (strcmp(tables->terminal_names[index], name) == 0) {
+            return index;
+        }
+    }
+
+    return -1;
+}
+
+/* Parses one expression, either a token at a time or all at once,
+ * and answers 1 if it didn't give the expected value, otherwise 0 */
+static int
+check_case(tpc_parser_t parser, const tpc_tables_t *tables,
+           const struct check_case *test, int batch)
+{
+    const char *how = batch ? "tpc_parser_feed_tokens" : "tpc_parser_feed";
+    tpc_token_t tokens[CHECK_MAX_TOKENS];
+    const char *names[CHECK_MAX_TOKENS];
+    char *values[CHECK_MAX_TOKENS];
+    void *result = NULL;
+    size_t consumed = 0;
+    int count;
+    int rc = TPC_OK;
+    int i;
+
+    check_clear();
+    if ((count = check_tokenize(test->input, names, values,
+                                CHECK_MAX_TOKENS)) < 0) {
+        fprintf(stderr, "can't split `%s' into tokens\n", test->input);
+        return 1;
+    }
+
+    for (i = 0; i < count; i++) {
+        if ((tokens[i].terminal = lookup_terminal(tables, names[i])) < 0) {
+            fprintf(stderr, "the tables have no terminal `%s'\n", names[i]);
+            return 1;
+        }
+
+        tokens[i].value = values[i];
+    }
+
+    /* Feed the tokens */
+    if (batch) {
+        rc = tpc_parser_feed_tokens(parser, tokens, count, &consumed,
+                                    &result);
+    } else {
+        while (rc == TPC_OK && consumed < (size_t)count) {
+            rc = tpc_parser_feed(parser, tokens[consumed].terminal,
+                                 tokens[consumed].value, &result);
+            consumed++;
+        }
+    }
+
+    /* A syntax error leaves the parser where it was */
+    if (test->expected == NULL) {
+        if (rc != TPC_ERR_SYNTAX) {
+            fprintf(stderr, "%s: `%s' gave %d, not a syntax error\n",
+                    how, test->input, rc);
+            return 1;
+        }
+
+        if (tpc_parser_reset(parser) < 0) {
+            fprintf(stderr, "%s: can't reset after `%s'\n",
+                    how, test->input);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    /* The accepted value is the last token's */
+    if (rc != TPC_ACCEPT || consumed != (size_t)count ||
+        strcmp((char *)result, test->expected) != 0) {
+        fprintf(stderr, "%s: `%s' gave %d and `%s', not `%s'\n",
+                how, test->input, rc,
+                rc == TPC_ACCEPT ? (char *)result : "", test->expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Compares what a call returned with what it should have */
+static int
+expect(const char *what, int rc, int expected)
+{
+    if (rc != expected) {
+        fprintf(stderr, "%s gave %d, not %d\n", what, rc, expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Feeds the named terminal to the parser with its name for a value */
+static int
+feed(tpc_parser_t parser, const tpc_tables_t *tables, const char *name,
+     void **result_out)
+{
+    return tpc_parser_feed(parser, lookup_terminal(tables, name),
+                           (void *)name, result_out);
+}
+
+/* Checks that terminals the tables don't have are syntax errors, and
+ * that a failed reduction discards the partial parse rather than
+ * carrying on without the popped frames */
+static int
+check_errors(const tpc_tables_t *tables)
+{
+    tpc_token_t tokens[2];
+    tpc_parser_t parser;
+    void *result = NULL;
+    size_t consumed;
+    int failures = 0;
+
+    if ((parser = tpc_parser_alloc(tables, 1, NULL)) == NULL) {
+        fprintf(stderr, "tpc_parser_alloc(): failed\n");
+        return 1;
+    }
+
+    /* Terminals out of range are refused without changing state */
+    failures += expect("feeding terminal -1",
+                       tpc_parser_feed(parser, -1, NULL, &result),
+                       TPC_ERR_SYNTAX);
+    failures += expect("feeding the terminal count",
+                       tpc_parser_feed(parser, tables->terminal_count, NULL,
+                                       &result),
+                       TPC_ERR_SYNTAX);
+    failures += expect("the state after them",
+                       tpc_parser_get_state(parser), 0);
+
+    tokens[0].terminal = lookup_terminal(tables, "number");
+    tokens[0].value = "1";
+    tokens[1].terminal = tables->terminal_count;
+    tokens[1].value = NULL;
+    failures += expect("feeding a bad second token",
+                       tpc_parser_feed_tokens(parser, tokens, 2, &consumed,
+                                              &result),
+                       TPC_ERR_SYNTAX);
+    failures += expect("the tokens consumed before it", (int)consumed, 1);
+    tpc_parser_reset(parser);
+
+    /* A reduction which fails forgets the `(' under it */
+    failing = "number";
+    failures += expect("feeding `('", feed(parser, tables, "lparen", &result),
+                       TPC_OK);
+    failures += expect("feeding `1'", feed(parser, tables, "number", &result),
+                       TPC_OK);
+    failures += expect("failing to reduce `1'",
+                       feed(parser, tables, "plus", &result),
+                       TPC_ERR_REDUCE);
+    failing = NULL;
+    failures += expect("feeding `2' afterwards",
+                       feed(parser, tables, "number", &result), TPC_OK);
+    failures += expect("feeding `)' after the parse was discarded",
+                       feed(parser, tables, "rparen", &result),
+                       TPC_ERR_SYNTAX);
+    tpc_parser_reset(parser);
+
+    /* And so does one which fails to accept */
+    failing = "finish";
+    failures += expect("feeding `1'", feed(parser, tables, "number", &result),
+                       TPC_OK);
+    failures += expect("failing to accept `1'",
+                       feed(parser, tables, "<EOF>", &result),
+                       TPC_ERR_REDUCE);
+    failing = NULL;
+    failures += expect("feeding `2' afterwards",
+                       feed(parser, tables, "number", &result), TPC_OK);
+    failures += expect("accepting `2'",
+                       feed(parser, tables, "<EOF>", &result), TPC_ACCEPT);
+    if (failures == 0 && strcmp((char *)result, "=number") != 0) {
+        fprintf(stderr, "accepting `2' gave `%s'\n", (char *)result);
+        failures++;
+    }
+
+    tpc_parser_free(parser);
+    check_clear();
+    return failures;
+}
+
+/* Parses each expression with the tables */
+int
+check_tables(const tpc_tables_t *tables)
+{
+    tpc_parser_t parser;
+    int failures = 0;
+    int i;
+
+    /* Begin with one frame so that the stack has to grow, and keep the
+     * parser from one expression to the next so that it must begin
+     * again by itself after accepting */
+    if ((parser = tpc_parser_alloc(tables, 1, NULL)) == NULL) {
+        fprintf(stderr, "tpc_parser_alloc(): failed\n");
+        return 1;
+    }
+
+    for (i = 0; check_cases[i].input != NULL; i++) {
+        failures += check_case(parser, tables, check_cases + i, 0);
+        failures += check_case(parser, tables, check_cases + i, 1);
+    }
+
+    tpc_parser_free(parser);
+    return failures + check_errors(tables);
+}
+
+
+/* Answers the named reduction's value, which is NULL if the pool is
+ * full, unless the reduction is meant to fail */
+static int
+reduce(const char *name, char *value, void **result_out)
+{
+    if (failing != NULL && strcmp(failing, name) == 0) {
+        return -1;
+    }
+
+    *result_out = value;
+    return value == NULL ? -1 : 0;
+}
+
+#define VALUE(index) ((char *)args[index].value)
+
+/* <statement> ::= <expr> */
+int
+finish(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("finish", check_format("=%s", VALUE(0)), result_out);
+}
+
+/* <expr> ::= <expr> plus <term> */
+int
+add(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("add", check_format("(%s+%s)", VALUE(0), VALUE(2)),
+                  result_out);
+}
+
+/* <expr> ::= <expr> minus <term> */
+int
+subtract(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("subtract", check_format("(%s-%s)", VALUE(0), VALUE(2)),
+                  result_out);
+}
+
+/* <expr> ::= <term> */
+int
+promote(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("promote", (char *)args[0].value, result_out);
+}
+
+/* <term> ::= <term> times <factor> */
+int
+multiply(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("multiply", check_format("(%s*%s)", VALUE(0), VALUE(2)),
+                  result_out);
+}
+
+/* <factor> ::= lparen <expr> rparen */
+int
+group(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("group", check_format("[%s]", VALUE(1)), result_out);
+}
+
+/* <factor> ::= <sign> number */
+int
+number(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("number", check_format("%s%s", VALUE(0), VALUE(1)),
+                  result_out);
+}
+
+/* <sign> ::= */
+int
+positive(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("positive", check_format("%s", ""), result_out);
+}
+
+/* <sign> ::= minus */
+int
+negative(void *rock, tpc_frame_t *args, void **result_out)
+{
+    return reduce("negative", check_format("-"), result_out);
+}
+
+/* <term> ::= <factor> */
+int
+pass(void *rock, tpc_frame_t *args, void **result_out)
+{
+    check_pass_count++;
+    *result_out = args[0].value;
+    return 0;
+}
@@ -0,0 +1,82 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "tpc_runtime.h"
+
+/* The most tokens an expression may have, counting the <EOF> */
+#define CHECK_MAX_TOKENS 64
+
+/* An expression and the value it should parse to, or NULL if it has
+ * a syntax error */
+struct check_case
+{
+    const char *input;
+    const char *expected;
+};
+
+/* The expressions, ending with one whose input is NULL */
+extern const struct check_case check_cases[];
+
+/* The number of times the pass reduction has been called */
+extern int check_pass_count;
+
+/* Splits an expression into at most count tokens, the last of them
+ * <EOF>, storing each one's terminal name and value.  Returns the
+ * number of tokens or -1 if the expression has a character which
+ * starts no token or too many tokens. */
+int check_tokenize(const char *input, const char **names, char **values,
+                   int count);
+
+/* Formats a value into a pool which lasts until check_clear().
+ * Returns NULL if the pool is full. */
+char *check_format(const char *format, ...);
+
+/* Empties the pool */
+void check_clear(void);
+
+/* Parses each expression with the tables, one token at a time and
+ * then all at once, checks how they handle bad terminals and failed
+ * reductions, and answers the number of failures reported */
+int check_tables(const tpc_tables_t *tables);
+
+#endif /* CHECK_H */
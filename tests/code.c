@@ -0,0 +1,263 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/* Parses check.c's expressions with the parser which tpc wrote with
+ * --emit=code, keeping its stacks as parser.c once did */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include "check.h"
+
+/* The parser's stacks, which never need to grow for check.c's
+ * expressions */
+typedef struct parser
+{
+    int states[2 * CHECK_MAX_TOKENS];
+    void *values[2 * CHECK_MAX_TOKENS];
+    int *state_top;
+    void **value_top;
+} *parser_t;
+
+/* Pushes a state and its value */
+static int
+push(parser_t self, int state, void *value)
+{
+    if (! (self->state_top + 1 < self->states + 2 * CHECK_MAX_TOKENS)) {
+        return -1;
+    }
+
+    /* The state stack is pre-increment */
+    *(++self->state_top) = state;
+
+    /* The value stack is post-increment */
+    *(self->value_top++) = value;
+    return 0;
+}
+
+/* Pops the components of a production, leaving their values just
+ * above the top of the value stack for its reduction */
+static void
+pop(parser_t self, int count)
+{
+    self->state_top -= count;
+    self->value_top -= count;
+}
+
+/* Returns the top of the state stack */
+static int
+top(parser_t self)
+{
+    return *(self->state_top);
+}
+
+#define VALUE(index) ((char *)self->value_top[index])
+
+/* <statement> ::= <expr> */
+static void *
+finish(parser_t self)
+{
+    return check_format("=%s", VALUE(0));
+}
+
+/* <expr> ::= <expr> plus <term> */
+static void *
+add(parser_t self)
+{
+    return check_format("(%s+%s)", VALUE(0), VALUE(2));
+}
+
+/* <expr> ::= <expr> minus <term> */
+static void *
+subtract(parser_t self)
+{
+    return check_format("(%s-%s)", VALUE(0), VALUE(2));
+}
+
+/* <expr> ::= <term> */
+static void *
+promote(parser_t self)
+{
+    return VALUE(0);
+}
+
+/* <term> ::= <term> times <factor> */
+static void *
+multiply(parser_t self)
+{
+    return check_format("(%s*%s)", VALUE(0), VALUE(2));
+}
+
+/* <factor> ::= lparen <expr> rparen */
+static void *
+group(parser_t self)
+{
+    return check_format("[%s]", VALUE(1));
+}
+
+/* <factor> ::= <sign> number */
+static void *
+number(parser_t self)
+{
+    return check_format("%s%s", VALUE(0), VALUE(1));
+}
+
+/* <sign> ::= */
+static void *
+positive(parser_t self)
+{
+    return check_format("%s", "");
+}
+
+/* <sign> ::= minus */
+static void *
+negative(parser_t self)
+{
+    return check_format("-");
+}
+
+/* <term> ::= <factor> */
+static void *
+pass(parser_t self)
+{
+    return VALUE(0);
+}
+
+#include "code.h"
+
+/* The terminals by name */
+static const struct
+{
+    const char *name;
+    terminal_t terminal;
+} terminals[] =
+{
+    { "<EOF>", TT_EOF },
+    { "plus", TT_plus },
+    { "minus", TT_minus },
+    { "times", TT_times },
+    { "lparen", TT_lparen },
+    { "rparen", TT_rparen },
+    { "number", TT_number }
+};
+
+/* Answers the named terminal, or -1 */
+static int
+lookup_terminal(const char *name)
+{
+    size_t index;
+
+    for (index = 0; index < sizeof(terminals) / sizeof(terminals[0]);
+         index++) {
+        if (strcmp(terminals[index].name, name) == 0) {
+            return terminals[index].terminal;
+        }
+    }
+
+    return -1;
+}
+
+/* Parses one expression and answers 1 if it didn't give the expected
+ * value, otherwise 0 */
+static int
+check_case(const struct check_case *test)
+{
+    const char *names[CHECK_MAX_TOKENS];
+    char *values[CHECK_MAX_TOKENS];
+    struct parser parser;
+    void *result = NULL;
+    int rc = TPC_OK;
+    int count;
+    int i;
+
+    check_clear();
+    parser.state_top = parser.states;
+    parser.states[0] = 0;
+    parser.value_top = parser.values;
+    if ((count = check_tokenize(test->input, names, values,
+                                CHECK_MAX_TOKENS)) < 0) {
+        fprintf(stderr, "can't split `%s' into tokens\n", test->input);
+        return 1;
+    }
+
+    for (i = 0; rc == TPC_OK && i < count; i++) {
+        int terminal = lookup_terminal(names[i]);
+
+        if (terminal < 0) {
+            fprintf(stderr, "there's no terminal `%s'\n", names[i]);
+            return 1;
+        }
+
+        rc = tpc_shift_reduce(&parser, (terminal_t)terminal, values[i],
+                              &result);
+    }
+
+    if (test->expected == NULL ?
+        rc != TPC_ERR_SYNTAX :
+        rc != TPC_ACCEPT || i != count ||
+        strcmp((char *)result, test->expected) != 0) {
+        fprintf(stderr, "`%s' gave %d and `%s', not `%s'\n",
+                test->input, rc, rc == TPC_ACCEPT ? (char *)result : "",
+                test->expected == NULL ? "a syntax error" : test->expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int failures = 0;
+    int i;
+
+    for (i = 0; check_cases[i].input != NULL; i++) {
+        failures += check_case(check_cases + i);
+    }
+
+    if (failures != 0) {
+        fprintf(stderr, "%s: %d failures\n", argv[0], failures);
+        return 1;
+    }
+
+    return 0;
+}
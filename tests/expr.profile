@@ -0,0 +1,18 @@
+# Made-up visit counts for the 16 states of expr.pcg, highest for
+# the last states so that --profile moves nearly every row.  State 3
+# is left out, as tpc_profile_write() leaves out unvisited states.
+1 100
+2 200
+4 400
+5 500
+6 600
+7 700
+8 800
+9 900
+10 1000
+11 1100
+12 1200
+13 1300
+14 1400
+15 1500
+0 1
@@ -0,0 +1,318 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+/* Loads the tables which `tpc --binary' wrote to expr.tpcb and parses
+ * check.c's expressions with them, then checks that the loader turns
+ * away copies with broken productions and that the driver refuses a
+ * production longer than its stack */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "check.h"
+#include "reductions.h"
+
+/* tpc_tables_load() needs what tpc_runtime.c needs for it */
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_PTHREAD_H)
+# define HAVE_LOADER 1
+#endif
+
+#ifdef HAVE_LOADER
+/* The table file, and the file in which to write broken copies */
+#define TABLE_FILE "expr.tpcb"
+#define BROKEN_FILE "broken.tpcb"
+
+/* The largest table file this reads */
+#define MAX_FILE_SIZE 65536
+
+/* The reductions of expr.pcg by name */
+static const struct
+{
+    const char *name;
+    tpc_reduction_t reduction;
+} reductions[] =
+{
+    { "finish", finish },
+    { "add", add },
+    { "subtract", subtract },
+    { "promote", promote },
+    { "multiply", multiply },
+    { "group", group },
+    { "number", number },
+    { "positive", positive },
+    { "negative", negative },
+    { "pass", pass }
+};
+
+/* The contents of the table file */
+static unsigned char original[MAX_FILE_SIZE];
+static size_t length;
+
+/* The copy being broken, and its header */
+static unsigned char broken[MAX_FILE_SIZE];
+static tpc_binary_header_t header;
+
+/* Looks up a reduction by name, unless rock names it */
+static tpc_reduction_t
+resolve(void *rock, const char *name)
+{
+    size_t index;
+
+    if (rock != NULL && strcmp((char *)rock, name) == 0) {
+        return NULL;
+    }
+
+    for (index = 0; index < sizeof(reductions) / sizeof(reductions[0]);
+         index++) {
+        if (strcmp(reductions[index].name, name) == 0) {
+            return reductions[index].reduction;
+        }
+    }
+
+    return NULL;
+}
+
+/* Reads the table file into original and its header */
+static int
+read_tables(void)
+{
+    FILE *file;
+
+    if ((file = fopen(TABLE_FILE, "rb")) == NULL) {
+        perror("unable to open " TABLE_FILE);
+        return -1;
+    }
+
+    length = fread(original, 1, sizeof(original), file);
+    fclose(file);
+    if (length < sizeof(header) || length == sizeof(original)) {
+        fprintf(stderr, TABLE_FILE ": bad size %lu\n", (unsigned long)length);
+        return -1;
+    }
+
+    memcpy(&header, original, sizeof(header));
+    return 0;
+}
+
+/* Answers the offset of one of the words of the named production's
+ * (nonterm_type, count) pair in the table file */
+static size_t
+production_word(const char *name, int word)
+{
+    uint32_t symbol_count = header.terminal_count + header.nonterminal_count;
+    uint32_t index;
+    uint32_t offset;
+
+    for (index = 0; index < header.production_count; index++) {
+        memcpy(&offset, original + header.names_offset +
+               (symbol_count + index) * 4, 4);
+        if (strcmp((char *)original + header.strings_offset + offset,
+                   name) == 0) {
+            return header.productions_offset + index * 8 + word * 4;
+        }
+    }
+
+    return 0;
+}
+
+/* Writes a copy of the table file with one word changed, fixing its
+ * checksum unless asked not to */
+static int
+write_broken(size_t offset, uint32_t value, int fix_checksum)
+{
+    FILE *file;
+    uint32_t checksum;
+
+    memcpy(broken, original, length);
+    memcpy(broken + offset, &value, 4);
+    if (fix_checksum) {
+        checksum = tpc_adler32(broken + sizeof(header),
+                               length - sizeof(header));
+        memcpy(broken + offsetof(tpc_binary_header_t, checksum),
+               &checksum, 4);
+    }
+
+    if ((file = fopen(BROKEN_FILE, "wb")) == NULL) {
+        perror("unable to open " BROKEN_FILE);
+        return -1;
+    }
+
+    if (fwrite(broken, 1, length, file) != length) {
+        perror("unable to write " BROKEN_FILE);
+        fclose(file);
+        return -1;
+    }
+
+    return fclose(file);
+}
+
+/* Checks that the loader turns away a copy with one word changed */
+static int
+check_refused(const char *what, size_t offset, uint32_t value,
+              int fix_checksum)
+{
+    tpc_tables_t *tables;
+
+    if (offset == 0 || write_broken(offset, value, fix_checksum) < 0) {
+        fprintf(stderr, "unable to write tables with %s\n", what);
+        return 1;
+    }
+
+    if ((tables = tpc_tables_load(BROKEN_FILE, resolve, NULL)) != NULL) {
+        fprintf(stderr, "tables with %s were loaded\n", what);
+        tpc_tables_release(tables);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Answers the named terminal's index in the tables */
+static int
+terminal(const tpc_tables_t *tables, const char *name)
+{
+    int index;
+
+    for (index = 0; index < tables->terminal_count; index++) {
+        if (strcmp(tables->terminal_names[index], name) == 0) {
+            break;
+        }
+    }
+
+    return index;
+}
+
+/* Checks that the driver refuses to reduce by a production with more
+ * components than its stack holds, which the loader can't know */
+static int
+check_too_deep(void)
+{
+    tpc_tables_t *tables;
+    tpc_parser_t parser;
+    void *result = NULL;
+    int failures = 0;
+    int rc;
+
+    if (write_broken(production_word("number", 1), 1000, 1) < 0 ||
+        (tables = tpc_tables_load(BROKEN_FILE, resolve, NULL)) == NULL) {
+        fprintf(stderr, "unable to load tables with a long production\n");
+        return 1;
+    }
+
+    if ((parser = tpc_parser_alloc(tables, 1, NULL)) == NULL) {
+        fprintf(stderr, "tpc_parser_alloc(): failed\n");
+        tpc_tables_release(tables);
+        return 1;
+    }
+
+    if ((rc = tpc_parser_feed(parser, terminal(tables, "number"), "1",
+                              &result)) != TPC_OK) {
+        fprintf(stderr, "feeding `1' gave %d\n", rc);
+        failures++;
+    } else if ((rc = tpc_parser_feed(parser, terminal(tables, "<EOF>"), NULL,
+                                     &result)) != TPC_ERR_SYNTAX) {
+        fprintf(stderr, "reducing a long production gave %d, not %d\n",
+                rc, TPC_ERR_SYNTAX);
+        failures++;
+    }
+
+    tpc_parser_free(parser);
+    tpc_tables_release(tables);
+    check_clear();
+    return failures;
+}
+#endif /* HAVE_LOADER */
+
+int
+main(int argc, char *argv[])
+{
+#ifdef HAVE_LOADER
+    tpc_tables_t *tables;
+    int failures = 0;
+
+    if (read_tables() < 0) {
+        return 1;
+    }
+
+    /* The tables as tpc wrote them */
+    if ((tables = tpc_tables_load(TABLE_FILE, resolve, NULL)) == NULL) {
+        fprintf(stderr, "%s: unable to load " TABLE_FILE "\n", argv[0]);
+        return 1;
+    }
+
+    failures += check_tables(tables);
+    tpc_tables_release(tables);
+
+    /* Tables the loader should turn away */
+    if ((tables = tpc_tables_load(TABLE_FILE, resolve, "multiply")) != NULL) {
+        fprintf(stderr, "tables with an unknown reduction were loaded\n");
+        tpc_tables_release(tables);
+        failures++;
+    }
+
+    failures += check_refused("a bad checksum",
+                              production_word("group", 1), 2, 0);
+    failures += check_refused("a nonterminal out of range",
+                              production_word("add", 0),
+                              header.nonterminal_count, 1);
+    failures += check_refused("too many components",
+                              production_word("group", 1), 0x10000, 1);
+    failures += check_refused("too many components",
+                              production_word("group", 1), 0xffffffff, 1);
+
+    /* And one only the driver can catch */
+    failures += check_too_deep();
+    remove(BROKEN_FILE);
+
+    if (failures != 0) {
+        fprintf(stderr, "%s: %d failures\n", argv[0], failures);
+        return 1;
+    }
+
+    return 0;
+#else /* HAVE_LOADER */
+    /* Tell make check to skip this */
+    fprintf(stderr, "%s: libtpc was built without a loader\n", argv[0]);
+    return 77;
+#endif /* HAVE_LOADER */
+}
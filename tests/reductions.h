@@ -0,0 +1,58 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+#ifndef REDUCTIONS_H
+#define REDUCTIONS_H
+
+#include "tpc_runtime.h"
+
+/* The reductions of expr.pcg for libtpc, which check.c defines */
+int finish(void *rock, tpc_frame_t *args, void **result_out);
+int add(void *rock, tpc_frame_t *args, void **result_out);
+int subtract(void *rock, tpc_frame_t *args, void **result_out);
+int promote(void *rock, tpc_frame_t *args, void **result_out);
+int multiply(void *rock, tpc_frame_t *args, void **result_out);
+int group(void *rock, tpc_frame_t *args, void **result_out);
+int number(void *rock, tpc_frame_t *args, void **result_out);
+int positive(void *rock, tpc_frame_t *args, void **result_out);
+int negative(void *rock, tpc_frame_t *args, void **result_out);
+int pass(void *rock, tpc_frame_t *args, void **result_out);
+
+#endif /* REDUCTIONS_H */
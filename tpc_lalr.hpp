@@ -0,0 +1,1193 @@
+/* -*- mode: c++; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+
+/*
+ * A header-only C++20 port of tpc's LALR(1) construction which runs
+ * entirely at compile time over a grammar written in .pcg syntax:
+ *
+ *     constexpr auto &tables = tpc::lalr<R"(
+ *         <sum> ::= <sum> PLUS NUM [add]
+ *         <sum> ::= NUM [make_sum]
+ *     )">::tables;
+ *
+ * The result holds the same tables that `tpc --action-encoding=tagged'
+ * writes for the grammar.  The whole construction is evaluated by the
+ * compiler; grammars the size of e4.pcg and st80.pcg fit within gcc's
+ * default limits, but larger ones may need a higher
+ * -fconstexpr-ops-limit (gcc) or -fconstexpr-steps (clang).
+ */
+
+#ifndef TPC_LALR_HPP
+#define TPC_LALR_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace tpc
+{
+
+// A string literal which can be used as a template argument
+template <std::size_t Size>
+struct fixed_string
+{
+    char data[Size];
+
+    constexpr fixed_string(const char (&source)[Size])
+    {
+        std::copy(source, source + Size, data);
+    }
+
+    constexpr std::string_view view() const
+    {
+        return std::string_view(data, Size - 1);
+    }
+};
+
+// The narrowest unsigned type which can hold values up to Max
+template <std::size_t Max>
+using uint_for = std::conditional_t<
+    Max <= 0xff, std::uint8_t,
+    std::conditional_t<Max <= 0xffff, std::uint16_t, std::uint32_t>>;
+
+// A production as recorded in the tables
+struct production_info
+{
+    // The index of the nonterminal to which the production reduces
+    int nonterm_type;
+
+    // The number of components on its right-hand side
+    int count;
+
+    // The name of its reduction
+    std::string_view reduction;
+};
+
+// The tables computed for a grammar.  The low two bits of each
+// action are 0 for an error, 1 for a shift, 2 for a reduction or 3
+// to accept, and the rest are the target state or production.
+template <std::size_t T, std::size_t N, std::size_t P, std::size_t K>
+struct lalr_tables
+{
+    using action_t = uint_for<(((P > K ? P : K) - 1) << 2) | 3>;
+    using state_t = uint_for<K - 1>;
+
+    static constexpr std::size_t terminal_count = T;
+    static constexpr std::size_t nonterminal_count = N;
+    static constexpr std::size_t production_count = P;
+    static constexpr std::size_t kernel_count = K;
+
+    std::array<std::string_view, T> terminal_names;
+    std::array<std::string_view, N> nonterminal_names;
+    std::array<production_info, P> productions;
+
+    // Indexed by state * terminal_count + terminal
+    std::array<action_t, K * T> sr_table;
+
+    // Indexed by state * nonterminal_count + nonterminal
+    std::array<state_t, K * N> goto_table;
+
+    // The number of shift/reduce and reduce/reduce conflicts which
+    // were resolved (tpc would have warned about each of them)
+    int conflicts;
+};
+
+namespace detail
+{
+
+// Reports an error in the grammar.  Since this isn't constexpr, a
+// call to it stops constant evaluation and the compiler's diagnostic
+// shows the message.
+[[noreturn]] inline void
+fail(const char *message)
+{
+    (void)message;
+    std::abort();
+}
+
+
+// A set of terminals, 64 to a word
+using terminal_set = std::vector<std::uint64_t>;
+
+constexpr bool
+set_contains(const terminal_set &set, int index)
+{
+    return (set[index / 64] >> (index % 64)) & 1;
+}
+
+// Adds the terminal to the set, returning true if it wasn't there
+constexpr bool
+set_insert(terminal_set &set, int index)
+{
+    std::uint64_t bit = std::uint64_t(1) << (index % 64);
+
+    if (set[index / 64] & bit) {
+        return false;
+    }
+
+    set[index / 64] |= bit;
+    return true;
+}
+
+constexpr bool
+set_is_empty(const terminal_set &set)
+{
+    for (std::uint64_t word : set) {
+        if (word != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Adds the source terminals to the set, returning true if it grew
+constexpr bool
+set_merge(terminal_set &set, const terminal_set &source)
+{
+    bool changed = false;
+
+    for (std::size_t i = 0; i < set.size(); i++) {
+        if (source[i] & ~set[i]) {
+            set[i] |= source[i];
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+
+// A reference to a terminal or nonterminal symbol
+struct symbol
+{
+    bool nonterminal;
+    int index;
+};
+
+// A production rule
+struct production
+{
+    int nonterminal;
+    std::vector<symbol> components;
+    std::string_view reduction;
+
+    // The terminal whose precedence the production has, or -1
+    int precedence;
+};
+
+// The associativities of a terminal with a declared precedence
+enum associativity
+{
+    ASSOC_LEFT,
+    ASSOC_RIGHT,
+    ASSOC_NONASSOC
+};
+
+// A terminal's declared precedence, where higher levels bind more
+// tightly and level 0 means none was declared
+struct precedence
+{
+    int level;
+    associativity assoc;
+};
+
+// A kernel (LR(0) item set) and the tables computed for it
+struct kernel
+{
+    // The encoded (production, offset) pairs
+    std::vector<int> pairs;
+
+    // The kernel to go to on each nonterminal and then each terminal
+    std::vector<int> goto_table;
+
+    // The index of the kernel's first pair in the builder's tables of
+    // kernel items
+    int first_item;
+
+    // The action for each terminal
+    std::vector<int> actions;
+};
+
+
+// The lookaheads which an item whose next component is a given
+// nonterminal gives to the productions in its closure
+struct derivation
+{
+    // The productions given lookaheads regardless of the item's own
+    std::vector<int> productions;
+    std::vector<terminal_set> lookaheads;
+
+    // The productions to which the terminals following the
+    // nonterminal are passed on
+    std::vector<int> propagates;
+};
+
+
+// Reads a grammar in .pcg syntax.  Symbols are numbered in order of
+// appearance, with <EOF> as terminal 0, just as tpc numbers them.
+class reader
+{
+public:
+    constexpr explicit reader(std::string_view source)
+        : source_(source), point_(0)
+    {
+        intern_terminal("<EOF>");
+        while (skip_space()) {
+            if (source_[point_] == '%') {
+                read_precedence();
+            } else {
+                read_production();
+            }
+        }
+
+        if (productions.empty()) {
+            fail("the grammar has no productions");
+        }
+    }
+
+    std::vector<std::string_view> terminals;
+    std::vector<std::string_view> nonterminals;
+    std::vector<production> productions;
+
+    // The declared precedence of each terminal
+    std::vector<precedence> precedences;
+
+private:
+    static constexpr bool
+    is_id_start(char ch)
+    {
+        return ch == '_' || ('a' <= ch && ch <= 'z') ||
+            ('A' <= ch && ch <= 'Z');
+    }
+
+    static constexpr bool
+    is_id_char(char ch)
+    {
+        return is_id_start(ch) || ch == '-' || ('0' <= ch && ch <= '9');
+    }
+
+    // Skips whitespace and comments, returning false at the end
+    constexpr bool
+    skip_space()
+    {
+        while (point_ < source_.size()) {
+            char ch = source_[point_];
+
+            if (ch == '#') {
+                while (point_ < source_.size() && source_[point_] != '\n') {
+                    point_++;
+                }
+            } else if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' ||
+                       ch == '\f' || ch == '\v') {
+                point_++;
+            } else {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Consumes the given punctuation or fails
+    constexpr void
+    expect(std::string_view token)
+    {
+        if (! skip_space() || source_.substr(point_, token.size()) != token) {
+            fail("parse error in grammar");
+        }
+
+        point_ += token.size();
+    }
+
+    constexpr std::string_view
+    read_id()
+    {
+        std::size_t start;
+
+        if (! skip_space() || ! is_id_start(source_[point_])) {
+            fail("parse error in grammar");
+        }
+
+        start = point_;
+        while (point_ < source_.size() && is_id_char(source_[point_])) {
+            point_++;
+        }
+
+        return source_.substr(start, point_ - start);
+    }
+
+    static constexpr int
+    intern(std::vector<std::string_view> &table, std::string_view name)
+    {
+        for (std::size_t index = 0; index < table.size(); index++) {
+            if (table[index] == name) {
+                return static_cast<int>(index);
+            }
+        }
+
+        table.push_back(name);
+        return static_cast<int>(table.size() - 1);
+    }
+
+    constexpr int
+    intern_terminal(std::string_view name)
+    {
+        int index = intern(terminals, name);
+
+        precedences.resize(terminals.size(),
+                           precedence { 0, ASSOC_NONASSOC });
+        return index;
+    }
+
+    // Reads the name of a directive after its `%'
+    constexpr std::string_view
+    read_directive()
+    {
+        std::size_t start;
+
+        expect("%");
+        start = point_;
+        while (point_ < source_.size() && is_id_start(source_[point_])) {
+            point_++;
+        }
+
+        return source_.substr(start, point_ - start);
+    }
+
+    // <precedence> ::= LEFT|RIGHT|NONASSOC <terminal-list>
+    constexpr void
+    read_precedence()
+    {
+        std::string_view directive = read_directive();
+        associativity assoc;
+
+        if (directive == "left") {
+            assoc = ASSOC_LEFT;
+        } else if (directive == "right") {
+            assoc = ASSOC_RIGHT;
+        } else if (directive == "nonassoc") {
+            assoc = ASSOC_NONASSOC;
+        } else if (directive == "start") {
+            fail("%start is not supported at compile time");
+        } else {
+            fail("unknown directive in grammar");
+        }
+
+        // Later declarations bind more tightly
+        level_++;
+        while (skip_space() && source_[point_] != '<' &&
+               source_[point_] != '%') {
+            int terminal = intern_terminal(read_id());
+
+            if (precedences[terminal].level != 0) {
+                fail("precedence declared twice");
+            }
+
+            precedences[terminal] = precedence { level_, assoc };
+        }
+    }
+
+    // <nonterminal> ::= LT ID GT
+    constexpr int
+    read_nonterminal()
+    {
+        std::string_view name;
+
+        expect("<");
+        name = read_id();
+        expect(">");
+        return intern(nonterminals, name);
+    }
+
+    // <production> ::= <nonterminal> DERIVES <exp-list> <reduction>
+    // <production> ::= <nonterminal> DERIVES <exp-list> PREC <terminal>
+    //                  <reduction>
+    constexpr void
+    read_production()
+    {
+        production result;
+
+        result.nonterminal = read_nonterminal();
+        result.precedence = -1;
+        expect("::=");
+
+        // Read components until the reduction
+        while (skip_space() && source_[point_] != '[' &&
+               source_[point_] != '%') {
+            if (source_[point_] == '<') {
+                result.components.push_back(
+                    symbol { true, read_nonterminal() });
+            } else {
+                result.components.push_back(
+                    symbol { false, intern_terminal(read_id()) });
+                result.precedence = result.components.back().index;
+            }
+        }
+
+        // Empty productions need a nullable analysis which only
+        // grammar.c does so far
+        if (result.components.empty()) {
+            fail("empty productions are not supported at compile time");
+        }
+
+        // The production takes the precedence of its last terminal
+        // unless another is named
+        if (point_ < source_.size() && source_[point_] == '%') {
+            if (read_directive() != "prec") {
+                fail("unknown directive in grammar");
+            }
+
+            result.precedence = intern_terminal(read_id());
+        }
+
+        expect("[");
+        result.reduction = read_id();
+        expect("]");
+        productions.push_back(result);
+    }
+
+    std::string_view source_;
+    std::size_t point_;
+
+    // The number of precedence levels declared so far
+    int level_ = 0;
+};
+
+
+// The LALR(1) construction, following grammar.c closely enough that
+// the kernels are numbered and conflicts resolved in the same way
+class builder
+{
+public:
+    constexpr explicit builder(std::string_view source)
+        : grammar(source),
+          T(static_cast<int>(grammar.terminals.size())),
+          N(static_cast<int>(grammar.nonterminals.size())),
+          P(static_cast<int>(grammar.productions.size())),
+          W((T + 63) / 64),
+          conflicts(0)
+    {
+        compute_productions_by_nonterminal();
+        compute_generates();
+        compute_closures();
+        compute_firsts();
+        compute_derivations();
+        compute_LR0_kernels();
+        compute_propagates();
+        compute_actions();
+    }
+
+    reader grammar;
+    int T, N, P;
+
+    // The number of words in a terminal_set
+    int W;
+
+    std::vector<std::vector<int>> productions_by_nonterminal;
+    std::vector<std::vector<char>> generates;
+
+    // For each nonterminal, the (component index, pair) entries which
+    // its closure adds to a kernel's goto table
+    std::vector<std::vector<int>> closures;
+
+    // The terminals which may begin each nonterminal, and a set
+    // holding just each terminal
+    std::vector<terminal_set> firsts;
+    std::vector<terminal_set> singletons;
+
+    // For each nonterminal, those whose productions inherit its
+    // lookaheads by ending a production derived from it (including
+    // itself)
+    std::vector<std::vector<int>> inheritors;
+
+    // The derivation of each nonterminal
+    std::vector<derivation> derivations;
+
+    std::vector<kernel> kernels;
+
+    // The kernels indexed by their first (largest) pair
+    std::vector<std::vector<int>> kernels_by_pair;
+
+    // For each kernel item, the terminals which may follow it
+    std::vector<terminal_set> follows;
+
+    // For each kernel item, the items to which its follows propagate
+    std::vector<std::vector<int>> propagates;
+
+    int conflicts;
+
+    static constexpr int ERR_ACTION = -1;
+    static constexpr int ACC_ACTION = 0;
+
+    // Returns the action encoded as in `tpc --action-encoding=tagged'
+    constexpr unsigned long
+    tagged_action(int action) const
+    {
+        if (P <= action) {
+            return (static_cast<unsigned long>(action - P) << 2) | 1;
+        }
+
+        if (0 < action) {
+            return (static_cast<unsigned long>(action) << 2) | 2;
+        }
+
+        return action == ACC_ACTION ? 3 : 0;
+    }
+
+private:
+    constexpr const symbol *
+    component(int pi, int offset) const
+    {
+        const production &rule = grammar.productions[pi];
+
+        if (offset < static_cast<int>(rule.components.size())) {
+            return &rule.components[offset];
+        }
+
+        return nullptr;
+    }
+
+    constexpr int
+    component_index(const symbol &sym) const
+    {
+        return sym.nonterminal ? sym.index : N + sym.index;
+    }
+
+    constexpr int
+    encode(int index, int offset) const
+    {
+        return P * (offset + 1) - index - 1;
+    }
+
+    constexpr int
+    decode(int code, int &index_out) const
+    {
+        index_out = P - (code % P) - 1;
+        return code / P;
+    }
+
+    constexpr void
+    compute_productions_by_nonterminal()
+    {
+        productions_by_nonterminal.resize(N);
+        for (int pi = 0; pi < P; pi++) {
+            productions_by_nonterminal[grammar.productions[pi].nonterminal]
+                .push_back(pi);
+        }
+
+        for (int ni = 0; ni < N; ni++) {
+            if (productions_by_nonterminal[ni].empty()) {
+                fail("no rule to generate a nonterminal");
+            }
+        }
+    }
+
+    constexpr void
+    mark_generates(int generator, int generated)
+    {
+        if (generates[generator][generated]) {
+            return;
+        }
+
+        generates[generator][generated] = 1;
+        for (int index = 0; index < N; index++) {
+            if (generates[index][generator]) {
+                mark_generates(index, generated);
+            }
+        }
+
+        for (int index = 0; index < N; index++) {
+            if (generates[generated][index]) {
+                mark_generates(generator, index);
+            }
+        }
+    }
+
+    constexpr void
+    compute_generates()
+    {
+        generates.assign(N, std::vector<char>(N, 0));
+        for (int pi = 0; pi < P; pi++) {
+            const symbol &first = grammar.productions[pi].components[0];
+
+            if (first.nonterminal) {
+                mark_generates(grammar.productions[pi].nonterminal,
+                               first.index);
+            }
+        }
+    }
+
+    constexpr void
+    compute_closures()
+    {
+        closures.resize(N);
+        for (int ni = 0; ni < N; ni++) {
+            for (int i = 0; i < N; i++) {
+                if (ni == i || generates[ni][i]) {
+                    for (int probe : productions_by_nonterminal[i]) {
+                        const production &rule = grammar.productions[probe];
+
+                        closures[ni].push_back(
+                            component_index(rule.components[0]));
+                        closures[ni].push_back(encode(probe, 1));
+                    }
+                }
+            }
+        }
+    }
+
+    constexpr int
+    intern_kernel(std::vector<int> &pairs)
+    {
+        if (pairs.empty()) {
+            return -1;
+        }
+
+        for (int index : kernels_by_pair[pairs[0]]) {
+            if (kernels[index].pairs == pairs) {
+                return index;
+            }
+        }
+
+        kernels_by_pair[pairs[0]].push_back(static_cast<int>(kernels.size()));
+
+        kernel result;
+        result.first_item = static_cast<int>(follows.size());
+        follows.resize(follows.size() + pairs.size(), terminal_set(W, 0));
+        result.pairs = pairs;
+        kernels.push_back(result);
+        return static_cast<int>(kernels.size() - 1);
+    }
+
+    // Inserts a pair into a table kept in descending order
+    static constexpr void
+    add_pairs_entry(std::vector<int> &entry, int pair)
+    {
+        std::size_t i;
+
+        for (i = entry.size(); i > 0; i--) {
+            if (pair == entry[i - 1]) {
+                return;
+            }
+
+            if (pair < entry[i - 1]) {
+                break;
+            }
+        }
+
+        entry.insert(entry.begin() + i, pair);
+    }
+
+    constexpr void
+    compute_pairs(const kernel &source, std::vector<std::vector<int>> &table)
+    {
+        for (int code : source.pairs) {
+            int pi;
+            int offset = decode(code, pi);
+            const symbol *sym = component(pi, offset);
+
+            if (sym != nullptr) {
+                add_pairs_entry(table[component_index(*sym)],
+                                encode(pi, offset + 1));
+            }
+        }
+
+        // Add the closure of each item using the generates table.
+        // The entries are sets, so each nonterminal need only be
+        // closed once.
+        std::vector<char> closed(N, 0);
+        for (int code : source.pairs) {
+            int pi;
+            int offset = decode(code, pi);
+            const symbol *sym = component(pi, offset);
+
+            if (sym == nullptr || ! sym->nonterminal || closed[sym->index]) {
+                continue;
+            }
+
+            closed[sym->index] = 1;
+
+            const std::vector<int> &entries = closures[sym->index];
+            for (std::size_t i = 0; i < entries.size(); i += 2) {
+                add_pairs_entry(table[entries[i]], entries[i + 1]);
+            }
+        }
+    }
+
+    constexpr void
+    compute_LR0_kernels()
+    {
+        std::vector<int> seed(1, encode(0, 0));
+        std::size_t longest = 0;
+
+        for (const production &rule : grammar.productions) {
+            longest = std::max(longest, rule.components.size());
+        }
+
+        kernels_by_pair.resize(encode(0, static_cast<int>(longest)) + 1);
+        intern_kernel(seed);
+        for (std::size_t i = 0; i < kernels.size(); i++) {
+            std::vector<std::vector<int>> table(N + T);
+            std::vector<int> goto_table(N + T);
+
+            compute_pairs(kernels[i], table);
+            for (int j = 0; j < N + T; j++) {
+                goto_table[j] = intern_kernel(table[j]);
+            }
+
+            kernels[i].goto_table = goto_table;
+        }
+    }
+
+    constexpr void
+    mark_firsts(int nonterminal, terminal_set &table,
+                std::vector<char> &tried) const
+    {
+        for (int probe : productions_by_nonterminal[nonterminal]) {
+            if (! tried[probe]) {
+                const symbol &first = grammar.productions[probe].components[0];
+
+                tried[probe] = 1;
+                if (first.nonterminal) {
+                    mark_firsts(first.index, table, tried);
+                } else {
+                    set_insert(table, first.index);
+                }
+            }
+        }
+    }
+
+    constexpr void
+    compute_firsts()
+    {
+        singletons.assign(T, terminal_set(W, 0));
+        for (int ti = 0; ti < T; ti++) {
+            set_insert(singletons[ti], ti);
+        }
+
+        firsts.assign(N, terminal_set(W, 0));
+        for (int ni = 0; ni < N; ni++) {
+            std::vector<char> tried(P, 0);
+
+            mark_firsts(ni, firsts[ni], tried);
+        }
+    }
+
+    constexpr void
+    mark_inherits(std::vector<char> &table, int nonterminal) const
+    {
+        if (table[nonterminal]) {
+            return;
+        }
+
+        table[nonterminal] = 1;
+        for (int probe : productions_by_nonterminal[nonterminal]) {
+            const symbol *sym = component(probe, 0);
+
+            if (sym->nonterminal && component(probe, 1) == nullptr) {
+                mark_inherits(table, sym->index);
+            }
+        }
+    }
+
+    // Computes the derivation of each nonterminal.  grammar.c finds
+    // the lookaheads of each kernel item's closure with a recursive
+    // walk over (terminal, production) pairs.  Since they depend only
+    // on the item's next component and what follows it, and every
+    // production of a nonterminal gets the same ones, they can be
+    // worked out once per nonterminal and applied to every item,
+    // which matters when the compiler is counting steps.
+    constexpr void
+    compute_derivations()
+    {
+        inheritors.resize(N);
+        for (int ni = 0; ni < N; ni++) {
+            std::vector<char> table(N, 0);
+
+            mark_inherits(table, ni);
+            for (int i = 0; i < N; i++) {
+                if (table[i]) {
+                    inheritors[ni].push_back(i);
+                }
+            }
+        }
+
+        derivations.resize(N);
+        for (int ni = 0; ni < N; ni++) {
+            std::vector<terminal_set> lookaheads(N, terminal_set(W, 0));
+            derivation &result = derivations[ni];
+
+            // Each production in the closure passes what follows its
+            // first component on to that component's productions
+            for (int i = 0; i < N; i++) {
+                if (i != ni && ! generates[ni][i]) {
+                    continue;
+                }
+
+                for (int probe : productions_by_nonterminal[i]) {
+                    const symbol *sym = component(probe, 0);
+                    const symbol *next = component(probe, 1);
+
+                    if (! sym->nonterminal || next == nullptr) {
+                        continue;
+                    }
+
+                    for (int heir : inheritors[sym->index]) {
+                        set_merge(lookaheads[heir],
+                                  next->nonterminal ? firsts[next->index]
+                                                    : singletons[next->index]);
+                    }
+                }
+            }
+
+            for (int i = 0; i < N; i++) {
+                if (! set_is_empty(lookaheads[i])) {
+                    for (int probe : productions_by_nonterminal[i]) {
+                        result.productions.push_back(probe);
+                        result.lookaheads.push_back(lookaheads[i]);
+                    }
+                }
+            }
+
+            for (int heir : inheritors[ni]) {
+                for (int probe : productions_by_nonterminal[heir]) {
+                    result.propagates.push_back(probe);
+                }
+            }
+        }
+    }
+
+    // Returns the index of the item which follows the given one on
+    // its next component (which must exist) in kernel ki
+    constexpr int
+    goto_item(int ki, int pi, int offset) const
+    {
+        const symbol &sym = *component(pi, offset);
+        const kernel &target =
+            kernels[kernels[ki].goto_table[component_index(sym)]];
+        int code = encode(pi, offset + 1);
+
+        for (std::size_t i = 0; i < target.pairs.size(); i++) {
+            if (target.pairs[i] == code) {
+                return target.first_item + static_cast<int>(i);
+            }
+        }
+
+        fail("kernel item not found");
+    }
+
+    // Adds the lookaheads which the kernel item generates spontaneously
+    // to the items of its goto kernels, and records those to which its
+    // own follows propagate
+    constexpr void
+    compute_propagates_for(int ki, int index)
+    {
+        std::vector<int> &targets = propagates[kernels[ki].first_item + index];
+        const symbol *sym;
+        const symbol *next;
+        int pi;
+        int offset = decode(kernels[ki].pairs[index], pi);
+
+        if ((sym = component(pi, offset)) == nullptr) {
+            return;
+        }
+
+        targets.push_back(goto_item(ki, pi, offset));
+        if (! sym->nonterminal) {
+            return;
+        }
+
+        const derivation &derived = derivations[sym->index];
+        for (std::size_t i = 0; i < derived.productions.size(); i++) {
+            set_merge(follows[goto_item(ki, derived.productions[i], 0)],
+                      derived.lookaheads[i]);
+        }
+
+        if ((next = component(pi, offset + 1)) == nullptr) {
+            for (int probe : derived.propagates) {
+                targets.push_back(goto_item(ki, probe, 0));
+            }
+        } else {
+            for (int probe : derived.propagates) {
+                set_merge(follows[goto_item(ki, probe, 0)],
+                          next->nonterminal ? firsts[next->index]
+                                            : singletons[next->index]);
+            }
+        }
+    }
+
+    constexpr void
+    compute_propagates()
+    {
+        int count = static_cast<int>(follows.size());
+        std::vector<int> queue;
+        std::vector<char> queued(count, 1);
+
+        propagates.resize(count);
+        for (std::size_t ki = 0; ki < kernels.size(); ki++) {
+            for (std::size_t index = 0; index < kernels[ki].pairs.size();
+                 index++) {
+                compute_propagates_for(static_cast<int>(ki),
+                                       static_cast<int>(index));
+            }
+        }
+
+        // Inject <EOF> into the start kernel's item and propagate the
+        // follows of each item until nothing changes
+        set_insert(follows[0], 0);
+        for (int item = count - 1; item >= 0; item--) {
+            queue.push_back(item);
+        }
+
+        while (! queue.empty()) {
+            int item = queue.back();
+
+            queue.pop_back();
+            queued[item] = 0;
+            for (int target : propagates[item]) {
+                if (set_merge(follows[target], follows[item]) &&
+                    ! queued[target]) {
+                    queued[target] = 1;
+                    queue.push_back(target);
+                }
+            }
+        }
+    }
+
+    constexpr int
+    first_production_index(const kernel &source) const
+    {
+        int result = P;
+
+        for (int code : source.pairs) {
+            int test;
+
+            decode(code, test);
+            result = std::min(result, test);
+        }
+
+        return result;
+    }
+
+    // Resolves a shift/reduce conflict by the declared precedences of
+    // the production and terminal, returning false if either has none
+    constexpr bool
+    resolve_by_precedence(int reduction, int terminal, int shift,
+                          int &action_out) const
+    {
+        int operator_index = grammar.productions[reduction].precedence;
+        precedence reduce;
+        precedence shift_by;
+
+        if (operator_index < 0) {
+            return false;
+        }
+
+        reduce = grammar.precedences[operator_index];
+        shift_by = grammar.precedences[terminal];
+        if (reduce.level == 0 || shift_by.level == 0) {
+            return false;
+        }
+
+        // The tighter binding wins; ties go by the terminal's
+        // associativity
+        if (reduce.level > shift_by.level ||
+            (reduce.level == shift_by.level &&
+             shift_by.assoc == ASSOC_LEFT)) {
+            action_out = reduction;
+        } else if (reduce.level < shift_by.level ||
+                   shift_by.assoc == ASSOC_RIGHT) {
+            action_out = P + shift;
+        } else {
+            action_out = ERR_ACTION;
+        }
+
+        return true;
+    }
+
+    constexpr void
+    compute_actions()
+    {
+        for (kernel &item_set : kernels) {
+            std::vector<int> reductions(T, -1);
+
+            for (std::size_t index = 0; index < item_set.pairs.size();
+                 index++) {
+                int pi;
+                int offset = decode(item_set.pairs[index], pi);
+
+                if (component(pi, offset) != nullptr) {
+                    continue;
+                }
+
+                for (int i = 0; i < T; i++) {
+                    if (set_contains(follows[item_set.first_item + index],
+                                     i)) {
+                        if (reductions[i] != -1) {
+                            conflicts++;
+                        } else {
+                            reductions[i] = pi;
+                        }
+                    }
+                }
+            }
+
+            item_set.actions.resize(T);
+            for (int index = 0; index < T; index++) {
+                int ki = item_set.goto_table[N + index];
+                int shift = ki < 0 ? 0 : ki;
+                int reduction = reductions[index];
+
+                if (shift != 0 && reduction != -1 &&
+                    resolve_by_precedence(reduction, index, shift,
+                                          item_set.actions[index])) {
+                    continue;
+                }
+
+                if (shift != 0) {
+                    if (reduction != -1) {
+                        conflicts++;
+                        if (reduction <
+                            first_production_index(kernels[shift])) {
+                            item_set.actions[index] = reduction;
+                        } else {
+                            item_set.actions[index] = P + shift;
+                        }
+                    } else {
+                        item_set.actions[index] = P + shift;
+                    }
+                } else if (reduction < 0) {
+                    item_set.actions[index] = ERR_ACTION;
+                } else {
+                    item_set.actions[index] = reduction;
+                }
+            }
+        }
+    }
+};
+
+// The dimensions of a grammar's tables
+struct dimensions
+{
+    std::size_t T, N, P, K;
+};
+
+constexpr dimensions
+measure(std::string_view source)
+{
+    builder result(source);
+
+    return dimensions {
+        static_cast<std::size_t>(result.T),
+        static_cast<std::size_t>(result.N),
+        static_cast<std::size_t>(result.P),
+        result.kernels.size()
+    };
+}
+
+template <std::size_t T, std::size_t N, std::size_t P, std::size_t K>
+constexpr lalr_tables<T, N, P, K>
+build(std::string_view source)
+{
+    using tables_t = lalr_tables<T, N, P, K>;
+    builder result(source);
+    tables_t tables {};
+
+    for (std::size_t i = 0; i < T; i++) {
+        tables.terminal_names[i] = result.grammar.terminals[i];
+    }
+
+    for (std::size_t i = 0; i < N; i++) {
+        tables.nonterminal_names[i] = result.grammar.nonterminals[i];
+    }
+
+    for (std::size_t i = 0; i < P; i++) {
+        const production &rule = result.grammar.productions[i];
+
+        tables.productions[i] = production_info {
+            rule.nonterminal,
+            static_cast<int>(rule.components.size()),
+            rule.reduction
+        };
+    }
+
+    for (std::size_t k = 0; k < K; k++) {
+        const kernel &item_set = result.kernels[k];
+
+        for (std::size_t t = 0; t < T; t++) {
+            tables.sr_table[k * T + t] =
+                static_cast<typename tables_t::action_t>(
+                    result.tagged_action(item_set.actions[t]));
+        }
+
+        for (std::size_t n = 0; n < N; n++) {
+            int target = std::max(item_set.goto_table[n], 0);
+
+            tables.goto_table[k * N + n] =
+                static_cast<typename tables_t::state_t>(target);
+        }
+    }
+
+    tables.conflicts = result.conflicts;
+    return tables;
+}
+
+} // namespace detail
+
+// The tables for the grammar in Source, computed at compile time
+template <fixed_string Source>
+struct lalr
+{
+    static constexpr detail::dimensions size = detail::measure(Source.view());
+
+    static constexpr lalr_tables<size.T, size.N, size.P, size.K> tables =
+        detail::build<size.T, size.N, size.P, size.K>(Source.view());
+};
+
+} // namespace tpc
+
+#endif // TPC_LALR_HPP
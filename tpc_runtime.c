@@ -0,0 +1,1306 @@
+/* -*- mode: c; c-file-style: "elvin" -*- */
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_PTHREAD_H)
+# define HAVE_LOADER 1
+# include <fcntl.h>
+# include <unistd.h>
+# include <pthread.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+#include "tpc_runtime.h"
+
+/* The kinds of action in the shift/reduce table */
+#define ACTION_ERROR 0
+#define ACTION_SHIFT 1
+#define ACTION_REDUCE 2
+#define ACTION_ACCEPT 3
+
+/* The number of values a list first has room for */
+#define INITIAL_LIST_CAPACITY 4
+
+/* The most components a production in a binary table file may have */
+#define MAX_PRODUCTION_LENGTH 0xffff
+
+/* Counts an event when built with TPC_PROFILE, otherwise nothing */
+#ifdef TPC_PROFILE
+# define PROFILE_COUNT(self, counts, index) ((self)->profile.counts[index]++)
+#else
+# define PROFILE_COUNT(self, counts, index)
+#endif
+
+/* Tables which have been mapped in from a binary table file */
+struct mapped_tables
+{
+    /* The tables themselves (this must come first) */
+    tpc_tables_t tables;
+
+    /* The number of references to the tables */
+    int refcount;
+
+    /* The mapped file */
+    void *map;
+
+    /* The length of the mapping */
+    size_t length;
+
+    /* The productions, with their reductions looked up */
+    struct tpc_production *productions;
+
+    /* The names of the terminals followed by the nonterminals */
+    const char **names;
+};
+
+/* The table slot data structure */
+struct tpc_table_slot
+{
+    /* The current tables */
+    tpc_tables_t *current;
+};
+
+/* The parser data structure */
+struct tpc_parser
+{
+    /* The parse tables */
+    const tpc_tables_t *tables;
+
+    /* The slot from which to take the tables, if any */
+    tpc_table_slot_t slot;
+
+    /* The tables acquired from the slot */
+    tpc_tables_t *acquired;
+
+    /* The argument handed to each reduction */
+    void *rock;
+
+    /* The bottom of the stack */
+    tpc_frame_t *stack;
+
+    /* The end of the stack */
+    tpc_frame_t *end;
+
+    /* The top of the stack */
+    tpc_frame_t *top;
+
+    /* The entry point at which each parse begins */
+    int entry;
+
+    /* Nonzero if the last reset failed, so that the next feed must
+     * try it again before it parses anything */
+    int unready;
+
+#ifdef TPC_PROFILE
+    /* The counts gathered so far */
+    tpc_profile_t profile;
+#endif
+};
+
+
+/* Reads the indexed entry of a table whose entries are size bytes */
+static unsigned long
+read_entry(const void *table, int size, size_t index)
+{
+    switch (size) {
+    case 1:
+        return ((const uint8_t *)table)[index];
+
+    case 2:
+        return ((const uint16_t *)table)[index];
+
+    default:
+        return ((const uint32_t *)table)[index];
+    }
+}
+
+/* Splits an action into its kind and its state or production */
+static int
+decode_action(const tpc_tables_t *tables, unsigned long action, int *arg_out)
+{
+    /* Tagged actions keep their kind in the low bits */
+    if (tables->encoding == TPC_ENCODING_TAGGED) {
+        *arg_out = (int)(action >> 2);
+        return (int)(action & 3);
+    }
+
+    /* Otherwise the kind depends on the range the action falls in */
+    if (action == 0) {
+        return ACTION_ERROR;
+    }
+
+    if (action < (unsigned long)tables->production_count) {
+        *arg_out = (int)action;
+        return ACTION_REDUCE;
+    }
+
+    if (action < (unsigned long)(tables->production_count +
+                                 tables->kernel_count)) {
+        *arg_out = (int)action - tables->production_count;
+        return ACTION_SHIFT;
+    }
+
+    /* Accepting by a production other than the first counts on */
+    *arg_out = (int)(action - (unsigned long)(tables->production_count +
+                                              tables->kernel_count));
+    return ACTION_ACCEPT;
+}
+
+/* Doubles the size of the stack, answering the new top */
+static tpc_frame_t *
+grow_stack(tpc_parser_t self, tpc_frame_t *top)
+{
+    size_t count = self->end - self->stack;
+    tpc_frame_t *stack;
+
+    /* Try to allocate more memory for the stack */
+    stack = (tpc_frame_t *)realloc(self->stack,
+                                   count * 2 * sizeof(tpc_frame_t));
+    if (stack == NULL) {
+        return NULL;
+    }
+
+    /* Update the pointers */
+    top = top - self->stack + stack;
+    self->stack = stack;
+    self->end = stack + count * 2;
+    return top;
+}
+
+
+/* Appends a value to a list, doubling its room when it runs out */
+static int
+list_append(tpc_list_t *list, void *value)
+{
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity == 0 ?
+            INITIAL_LIST_CAPACITY : list->capacity * 2;
+        void **values;
+
+        if (capacity > (size_t)-1 / sizeof(void *)) {
+            return -1;
+        }
+
+        values = (void **)realloc(list->values, capacity * sizeof(void *));
+        if (values == NULL) {
+            return -1;
+        }
+
+        list->values = values;
+        list->capacity = capacity;
+    }
+
+    list->values[list->count++] = value;
+    return 0;
+}
+
+/* <X*> ::= */
+int
+tpc_list_empty(void *rock, tpc_frame_t *args, void **result_out)
+{
+    tpc_list_t *list;
+
+    if ((list = (tpc_list_t *)malloc(sizeof(tpc_list_t))) == NULL) {
+        return -1;
+    }
+
+    list->count = 0;
+    list->capacity = 0;
+    list->values = NULL;
+    *result_out = list;
+    return 0;
+}
+
+/* <X+> ::= X */
+int
+tpc_list_one(void *rock, tpc_frame_t *args, void **result_out)
+{
+    if (tpc_list_empty(rock, args, result_out) < 0) {
+        return -1;
+    }
+
+    if (list_append((tpc_list_t *)*result_out, args[0].value) < 0) {
+        tpc_list_free((tpc_list_t *)*result_out);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* <X*> ::= <X*> X */
+/* <X+> ::= <X+> X */
+int
+tpc_list_append(void *rock, tpc_frame_t *args, void **result_out)
+{
+    if (list_append((tpc_list_t *)args[0].value, args[1].value) < 0) {
+        return -1;
+    }
+
+    *result_out = args[0].value;
+    return 0;
+}
+
+/* <X?> ::= */
+int
+tpc_option_none(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = NULL;
+    return 0;
+}
+
+/* <X?> ::= X */
+int
+tpc_option_some(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = args[0].value;
+    return 0;
+}
+
+/* Answers the value of the one component */
+int
+tpc_pass(void *rock, tpc_frame_t *args, void **result_out)
+{
+    *result_out = args[0].value;
+    return 0;
+}
+
+/* Releases a list, but not the values in it */
+void
+tpc_list_free(tpc_list_t *list)
+{
+    free(list->values);
+    free(list);
+}
+
+/* Performs the reduction of a production of one of libtpc's own kinds */
+static int
+reduce_builtin(int kind, tpc_frame_t *args, void **result_out)
+{
+    switch (kind) {
+    case TPC_LIST_EMPTY:
+        return tpc_list_empty(NULL, args, result_out);
+
+    case TPC_LIST_ONE:
+        return tpc_list_one(NULL, args, result_out);
+
+    case TPC_LIST_APPEND:
+        return tpc_list_append(NULL, args, result_out);
+
+    case TPC_OPTION_NONE:
+        return tpc_option_none(NULL, args, result_out);
+
+    case TPC_OPTION_SOME:
+        return tpc_option_some(NULL, args, result_out);
+
+    case TPC_PASS:
+        return tpc_pass(NULL, args, result_out);
+
+    default:
+        return -1;
+    }
+}
+
+/* Computes the Adler-32 checksum of a buffer */
+uint32_t
+tpc_adler32(const void *buffer, size_t length)
+{
+    const unsigned char *point = (const unsigned char *)buffer;
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    while (length > 0) {
+        /* Reduce the sums only as often as they could overflow */
+        size_t count = length < 5552 ? length : 5552;
+
+        length -= count;
+        while (count-- > 0) {
+            a += *point++;
+            b += a;
+        }
+
+        a %= 65521;
+        b %= 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+
+#ifdef HAVE_LOADER
+/* Protects the reference counts and the slots' current tables */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns nonzero if the section lies within the file and is aligned */
+static int
+section_is_valid(const tpc_binary_header_t *header,
+                 uint32_t offset,
+                 size_t length)
+{
+    return offset % TPC_BINARY_ALIGN == 0 &&
+        sizeof(tpc_binary_header_t) <= offset &&
+        offset <= header->size &&
+        length <= header->size - offset;
+}
+
+/* Returns nonzero if every entry of the mapped tables is in range */
+static int
+entries_are_valid(const tpc_tables_t *tables)
+{
+    size_t count;
+    size_t index;
+    int arg;
+
+    /* Check the shift/reduce table */
+    count = (size_t)tables->kernel_count * tables->terminal_count;
+    for (index = 0; index < count; index++) {
+        unsigned long action = read_entry(tables->sr_table,
+                                          tables->action_size, index);
+
+        switch (decode_action(tables, action, &arg)) {
+        case ACTION_SHIFT:
+            if (! (arg < tables->kernel_count)) {
+                return 0;
+            }
+            break;
+
+        case ACTION_REDUCE:
+            if (! (0 < arg && arg < tables->production_count)) {
+                return 0;
+            }
+            break;
+
+        case ACTION_ACCEPT:
+            /* Only the first production or a %start one accepts */
+            if (arg != 0 &&
+                ! (0 < arg && arg < tables->production_count &&
+                   tables->kinds != NULL &&
+                   tables->kinds[arg] == TPC_PASS)) {
+                return 0;
+            }
+            break;
+        }
+    }
+
+    /* Check the goto table */
+    count = (size_t)tables->kernel_count * tables->nonterminal_count;
+    for (index = 0; index < count; index++) {
+        if (! (read_entry(tables->goto_table, tables->state_size, index) <
+               (unsigned long)tables->kernel_count)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/* Unmaps the tables and releases the resources they consume */
+static void
+mapped_tables_free(struct mapped_tables *self)
+{
+    if (self->map != NULL) {
+        munmap(self->map, self->length);
+    }
+
+    free(self->productions);
+    free(self->names);
+    free(self);
+}
+
+/* Answers libtpc's own reduction with the given name, if any, and
+ * stores the number of components it reduces in count_out */
+static tpc_reduction_t
+builtin_reduction(const char *name, uint32_t *count_out)
+{
+    static const struct
+    {
+        const char *name;
+        tpc_reduction_t reduction;
+        uint32_t count;
+    } builtins[] =
+    {
+        { "tpc_list_empty", tpc_list_empty, 0 },
+        { "tpc_list_one", tpc_list_one, 1 },
+        { "tpc_list_append", tpc_list_append, 2 },
+        { "tpc_option_none", tpc_option_none, 0 },
+        { "tpc_option_some", tpc_option_some, 1 },
+        { "tpc_pass", tpc_pass, 1 }
+    };
+    size_t index;
+
+    for (index = 0; index < sizeof(builtins) / sizeof(builtins[0]); index++) {
+        if (strcmp(name, builtins[index].name) == 0) {
+            *count_out = builtins[index].count;
+            return builtins[index].reduction;
+        }
+    }
+
+    return NULL;
+}
+
+/* Builds tables from the contents of a mapped file */
+static int
+mapped_tables_init(struct mapped_tables *self,
+                   tpc_resolver_t resolve,
+                   void *rock)
+{
+    const tpc_binary_header_t *header;
+    const unsigned char *base = (const unsigned char *)self->map;
+    const uint32_t *pairs;
+    const uint32_t *names;
+    const char *strings;
+    size_t strings_length;
+    uint32_t symbol_count;
+    uint32_t index;
+    uint32_t count;
+
+    /* Check the header */
+    header = (const tpc_binary_header_t *)base;
+    if (self->length < sizeof(tpc_binary_header_t) ||
+        header->magic != TPC_BINARY_MAGIC ||
+        header->version != TPC_BINARY_VERSION ||
+        header->size != self->length ||
+        header->checksum != tpc_adler32(base + sizeof(tpc_binary_header_t),
+                                        self->length -
+                                        sizeof(tpc_binary_header_t))) {
+        return -1;
+    }
+
+    /* Sanity check the table dimensions */
+    if (header->encoding > TPC_ENCODING_TAGGED ||
+        header->terminal_count == 0 || header->terminal_count > 0xffff ||
+        header->nonterminal_count == 0 ||
+        header->nonterminal_count > 0xffff ||
+        header->production_count == 0 ||
+        header->production_count > 0xffffff ||
+        header->kernel_count == 0 || header->kernel_count > 0xffffff ||
+        (header->action_size != 1 && header->action_size != 2 &&
+         header->action_size != 4) ||
+        (header->state_size != 1 && header->state_size != 2 &&
+         header->state_size != 4)) {
+        return -1;
+    }
+
+    /* Make sure each section fits in the file */
+    symbol_count = header->terminal_count + header->nonterminal_count;
+    if (! section_is_valid(header, header->productions_offset,
+                           (size_t)header->production_count * 8) ||
+        ! section_is_valid(header, header->sr_table_offset,
+                           (size_t)header->kernel_count *
+                           header->terminal_count * header->action_size) ||
+        ! section_is_valid(header, header->goto_table_offset,
+                           (size_t)header->kernel_count *
+                           header->nonterminal_count * header->state_size) ||
+        ! section_is_valid(header, header->names_offset,
+                           ((size_t)symbol_count +
+                            header->production_count) * 4) ||
+        ! section_is_valid(header, header->strings_offset, 1)) {
+        return -1;
+    }
+
+    pairs = (const uint32_t *)(base + header->productions_offset);
+    names = (const uint32_t *)(base + header->names_offset);
+    strings = (const char *)(base + header->strings_offset);
+    strings_length = header->size - header->strings_offset;
+
+    /* Make sure every name is a terminated string in the strings section */
+    for (index = 0; index < symbol_count + header->production_count; index++) {
+        if (! (names[index] < strings_length) ||
+            memchr(strings + names[index], 0,
+                   strings_length - names[index]) == NULL) {
+            return -1;
+        }
+    }
+
+    /* Point the tables into the mapped file */
+    self->tables.encoding = (int)header->encoding;
+    self->tables.action_size = (int)header->action_size;
+    self->tables.state_size = (int)header->state_size;
+    self->tables.terminal_count = (int)header->terminal_count;
+    self->tables.nonterminal_count = (int)header->nonterminal_count;
+    self->tables.production_count = (int)header->production_count;
+    self->tables.kernel_count = (int)header->kernel_count;
+    self->tables.sr_table = base + header->sr_table_offset;
+    self->tables.goto_table = base + header->goto_table_offset;
+    if (! entries_are_valid(&self->tables)) {
+        return -1;
+    }
+
+    /* Look up the symbol names */
+    self->names = (const char **)malloc(symbol_count * sizeof(char *));
+    if (self->names == NULL) {
+        return -1;
+    }
+
+    for (index = 0; index < symbol_count; index++) {
+        self->names[index] = strings + names[index];
+    }
+
+    self->tables.terminal_names = self->names;
+    self->tables.nonterminal_names = self->names + header->terminal_count;
+
+    /* Build the productions, looking up each reduction */
+    self->productions = (struct tpc_production *)malloc(
+        header->production_count * sizeof(struct tpc_production));
+    if (self->productions == NULL) {
+        return -1;
+    }
+
+    for (index = 0; index < header->production_count; index++) {
+        struct tpc_production *production = self->productions + index;
+        const char *name = strings + names[symbol_count + index];
+
+        if (! (pairs[index * 2] < header->nonterminal_count) ||
+            pairs[index * 2 + 1] > MAX_PRODUCTION_LENGTH) {
+            return -1;
+        }
+
+        production->nonterm_type = (int)pairs[index * 2];
+        production->count = (int)pairs[index * 2 + 1];
+
+        /* libtpc supplies the reductions of its own kinds, which only
+         * work with the number of components they expect */
+        production->reduction = builtin_reduction(name, &count);
+        if (production->reduction != NULL) {
+            if (pairs[index * 2 + 1] != count) {
+                return -1;
+            }
+        } else if ((production->reduction = resolve(rock, name)) == NULL) {
+            return -1;
+        }
+    }
+
+    self->tables.productions = self->productions;
+    return 0;
+}
+
+/* Maps a binary table file into memory */
+tpc_tables_t *
+tpc_tables_load(const char *filename, tpc_resolver_t resolve, void *rock)
+{
+    struct mapped_tables *self;
+    struct stat info;
+    int fd;
+
+    /* Allocate and clear a new mapped_tables */
+    self = (struct mapped_tables *)calloc(1, sizeof(struct mapped_tables));
+    if (self == NULL) {
+        return NULL;
+    }
+
+    self->refcount = 1;
+
+    /* Map the file into memory */
+    if ((fd = open(filename, O_RDONLY)) < 0) {
+        free(self);
+        return NULL;
+    }
+
+    if (fstat(fd, &info) < 0 || info.st_size <= 0) {
+        close(fd);
+        free(self);
+        return NULL;
+    }
+
+    self->length = (size_t)info.st_size;
+    self->map = mmap(NULL, self->length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (self->map == MAP_FAILED) {
+        free(self);
+        return NULL;
+    }
+
+    /* Make sense of its contents */
+    if (mapped_tables_init(self, resolve, rock) < 0) {
+        mapped_tables_free(self);
+        return NULL;
+    }
+
+    return &self->tables;
+}
+
+/* Releases a reference to tables returned by tpc_tables_load() */
+void
+tpc_tables_release(tpc_tables_t *tables)
+{
+    struct mapped_tables *self = (struct mapped_tables *)tables;
+    int refcount;
+
+    pthread_mutex_lock(&lock);
+    refcount = --self->refcount;
+    pthread_mutex_unlock(&lock);
+
+    if (refcount == 0) {
+        mapped_tables_free(self);
+    }
+}
+
+/* Returns a new reference to the receiver's current tables */
+tpc_tables_t *
+tpc_table_slot_acquire(tpc_table_slot_t self)
+{
+    tpc_tables_t *tables;
+
+    pthread_mutex_lock(&lock);
+    if ((tables = self->current) != NULL) {
+        ((struct mapped_tables *)tables)->refcount++;
+    }
+    pthread_mutex_unlock(&lock);
+
+    return tables;
+}
+
+/* Loads a binary table file and makes it the receiver's current tables */
+int
+tpc_table_slot_load(tpc_table_slot_t self,
+                    const char *filename,
+                    tpc_resolver_t resolve,
+                    void *rock)
+{
+    tpc_tables_t *tables;
+    tpc_tables_t *old;
+
+    /* Load the new tables */
+    if ((tables = tpc_tables_load(filename, resolve, rock)) == NULL) {
+        return -1;
+    }
+
+    /* Swap them in */
+    pthread_mutex_lock(&lock);
+    old = self->current;
+    self->current = tables;
+    pthread_mutex_unlock(&lock);
+
+    /* Let go of the old ones */
+    if (old != NULL) {
+        tpc_tables_release(old);
+    }
+
+    return 0;
+}
+#else /* HAVE_LOADER */
+/* Binary table files need mmap() and pthreads */
+tpc_tables_t *
+tpc_tables_load(const char *filename, tpc_resolver_t resolve, void *rock)
+{
+    return NULL;
+}
+
+void
+tpc_tables_release(tpc_tables_t *tables)
+{
+}
+
+tpc_tables_t *
+tpc_table_slot_acquire(tpc_table_slot_t self)
+{
+    return NULL;
+}
+
+int
+tpc_table_slot_load(tpc_table_slot_t self,
+                    const char *filename,
+                    tpc_resolver_t resolve,
+                    void *rock)
+{
+    return -1;
+}
+#endif /* HAVE_LOADER */
+
+/* Allocates and initializes a new, empty tpc_table_slot_t */
+tpc_table_slot_t
+tpc_table_slot_alloc(void)
+{
+    tpc_table_slot_t self;
+
+    if ((self = (tpc_table_slot_t)malloc(sizeof(struct tpc_table_slot))) == NULL) {
+        return NULL;
+    }
+
+    self->current = NULL;
+    return self;
+}
+
+/* Releases the resources consumed by the receiver */
+void
+tpc_table_slot_free(tpc_table_slot_t self)
+{
+    if (self->current != NULL) {
+        tpc_tables_release(self->current);
+    }
+
+    free(self);
+}
+
+
+#ifdef TPC_PROFILE
+/* Releases the receiver's counts */
+static void
+profile_clear(tpc_parser_t self)
+{
+    free(self->profile.visits);
+    free(self->profile.reductions);
+    free(self->profile.errors);
+    memset(&self->profile, 0, sizeof(tpc_profile_t));
+}
+
+/* Makes sure the receiver's counts fit its tables, starting them
+ * again if they don't */
+static int
+profile_fit(tpc_parser_t self)
+{
+    const tpc_tables_t *tables = self->tables;
+    tpc_profile_t *profile = &self->profile;
+
+    if (profile->visits != NULL &&
+        profile->kernel_count == tables->kernel_count &&
+        profile->production_count == tables->production_count) {
+        return 0;
+    }
+
+    profile_clear(self);
+    profile->visits = (unsigned long *)calloc(
+        tables->kernel_count, sizeof(unsigned long));
+    profile->reductions = (unsigned long *)calloc(
+        tables->production_count, sizeof(unsigned long));
+    profile->errors = (unsigned long *)calloc(
+        tables->kernel_count, sizeof(unsigned long));
+    if (profile->visits == NULL || profile->reductions == NULL ||
+        profile->errors == NULL) {
+        profile_clear(self);
+        return -1;
+    }
+
+    profile->kernel_count = tables->kernel_count;
+    profile->production_count = tables->production_count;
+    profile->max_depth = 1;
+    return 0;
+}
+#endif /* TPC_PROFILE */
+
+/* Allocates and initializes a new tpc_parser_t */
+static tpc_parser_t
+parser_alloc(const tpc_tables_t *tables,
+             tpc_table_slot_t slot,
+             size_t capacity,
+             void *rock)
+{
+    tpc_parser_t self;
+
+    /* Allocate some memory for the new tpc_parser_t */
+    if ((self = (tpc_parser_t)malloc(sizeof(struct tpc_parser))) == NULL) {
+        return NULL;
+    }
+
+    /* We always need room for the initial frame and one more */
+    if (capacity < 2) {
+        capacity = 2;
+    }
+
+    /* Allocate the stack */
+    self->stack = (tpc_frame_t *)malloc(capacity * sizeof(tpc_frame_t));
+    if (self->stack == NULL) {
+        free(self);
+        return NULL;
+    }
+
+    /* Initialize its contents to sane values */
+    self->tables = tables;
+    self->slot = slot;
+    self->acquired = NULL;
+    self->rock = rock;
+    self->end = self->stack + capacity;
+    self->entry = 0;
+#ifdef TPC_PROFILE
+    memset(&self->profile, 0, sizeof(tpc_profile_t));
+#endif
+    if (tpc_parser_reset(self) < 0) {
+        tpc_parser_free(self);
+        return NULL;
+    }
+
+    return self;
+}
+
+/* Allocates and initializes a new tpc_parser_t with room for
+ * capacity frames on its stack */
+tpc_parser_t
+tpc_parser_alloc(const tpc_tables_t *tables, size_t capacity, void *rock)
+{
+    return parser_alloc(tables, NULL, capacity, rock);
+}
+
+/* Allocates and initializes a new tpc_parser_t which takes the
+ * current tables of the slot each time it begins a parse */
+tpc_parser_t
+tpc_parser_alloc_with_slot(tpc_table_slot_t slot, size_t capacity, void *rock)
+{
+    return parser_alloc(NULL, slot, capacity, rock);
+}
+
+/* Releases the resources consumed by the receiver */
+void
+tpc_parser_free(tpc_parser_t self)
+{
+    if (self->acquired != NULL) {
+        tpc_tables_release(self->acquired);
+    }
+
+#ifdef TPC_PROFILE
+    profile_clear(self);
+#endif
+    free(self->stack);
+    free(self);
+}
+
+/* Discards any partial parse so that parsing can start afresh */
+int
+tpc_parser_reset(tpc_parser_t self)
+{
+    self->unready = 1;
+
+    /* Pick up the slot's current tables */
+    if (self->slot != NULL) {
+        tpc_tables_t *tables = tpc_table_slot_acquire(self->slot);
+
+        if (tables == NULL) {
+            return -1;
+        }
+
+        if (self->acquired != NULL) {
+            tpc_tables_release(self->acquired);
+        }
+
+        self->acquired = tables;
+        self->tables = tables;
+    }
+
+    self->top = self->stack;
+    self->top->state = 0;
+    self->top->value = NULL;
+
+#ifdef TPC_PROFILE
+    /* Make room to count the tables' states and productions */
+    if (profile_fit(self) < 0) {
+        return -1;
+    }
+#endif
+
+    /* Begin in the entry point's state, if the tables still have it */
+    if (self->entry != 0) {
+        if (! (self->entry < self->tables->start_count)) {
+            return -1;
+        }
+
+        self->top->state = self->tables->start_states[self->entry];
+    }
+
+    self->unready = 0;
+    return 0;
+}
+
+/* Begins parsing at the numbered entry point */
+int
+tpc_parser_start(tpc_parser_t self, int entry)
+{
+    int previous = self->entry;
+
+    if (entry < 0) {
+        return -1;
+    }
+
+    self->entry = entry;
+    if (tpc_parser_reset(self) < 0) {
+        self->entry = previous;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Returns the receiver's current state */
+int
+tpc_parser_get_state(tpc_parser_t self)
+{
+    return self->top->state;
+}
+
+/* Answers nonzero if the terminal has an action in the state */
+static int
+state_expects(const tpc_tables_t *tables, int state, int terminal)
+{
+    const unsigned char *set;
+
+    /* Without the expected sets we have to look up the action */
+    if (tables->expected_size == 0) {
+        return read_entry(tables->sr_table, tables->action_size,
+                          (size_t)state * tables->terminal_count +
+                          terminal) != 0;
+    }
+
+    set = tables->expected_sets + tables->expected_size *
+        read_entry(tables->expected_index, tables->expected_index_size,
+                   state);
+    return (set[terminal >> 3] >> (terminal & 7)) & 1;
+}
+
+/* Answers nonzero if the terminal has an action in the current state */
+int
+tpc_parser_expects(tpc_parser_t self, int terminal)
+{
+    if (terminal < 0 || ! (terminal < self->tables->terminal_count)) {
+        return 0;
+    }
+
+    return state_expects(self->tables, self->top->state, terminal);
+}
+
+/* Stores the terminals with an action in the current state */
+size_t
+tpc_parser_get_expected(tpc_parser_t self, int *terminals, size_t count)
+{
+    const tpc_tables_t *tables = self->tables;
+    int state = self->top->state;
+    const unsigned char *set;
+    size_t found = 0;
+    int terminal;
+    int i;
+
+    /* Without the expected sets we have to try every terminal */
+    if (tables->expected_size == 0) {
+        for (terminal = 0; terminal < tables->terminal_count; terminal++) {
+            if (state_expects(tables, state, terminal)) {
+                if (found < count) {
+                    terminals[found] = terminal;
+                }
+
+                found++;
+            }
+        }
+
+        return found;
+    }
+
+    /* Otherwise go through the bits of the state's set */
+    set = tables->expected_sets + tables->expected_size *
+        read_entry(tables->expected_index, tables->expected_index_size,
+                   state);
+    for (i = 0; i < tables->expected_size; i++) {
+        unsigned int bits = set[i];
+
+        for (terminal = i * 8; bits != 0; terminal++, bits >>= 1) {
+            if (bits & 1) {
+                if (found < count) {
+                    terminals[found] = terminal;
+                }
+
+                found++;
+            }
+        }
+    }
+
+    return found;
+}
+
+/* Pushes a frame, growing the stack if necessary, and answers the
+ * new top of the stack or NULL if there's no memory */
+static tpc_frame_t *
+push(tpc_parser_t self, tpc_frame_t *top, int state, void *value)
+{
+    /* Make sure there's room for another frame */
+    if (! (top + 1 < self->end)) {
+        if ((top = grow_stack(self, top)) == NULL) {
+            return NULL;
+        }
+    }
+
+    top++;
+    top->state = state;
+    top->value = value;
+
+#ifdef TPC_PROFILE
+    /* Remember how deep the stack has been */
+    if (self->profile.max_depth < (size_t)(top - self->stack) + 1) {
+        self->profile.max_depth = (size_t)(top - self->stack) + 1;
+    }
+#endif
+    return top;
+}
+
+/* Answers the number of components on the production's right-hand
+ * side */
+static size_t
+production_length(const tpc_tables_t *tables, int production)
+{
+    if (tables->dispatch != NULL) {
+        return read_entry(tables->counts, tables->symbol_size, production);
+    }
+
+    return tables->productions[production].count;
+}
+
+/* Performs all possible reductions and then shifts in the terminal */
+int
+tpc_parser_feed(tpc_parser_t self, int terminal, void *value,
+                void **result_out)
+{
+    tpc_token_t token;
+    size_t consumed;
+
+    token.terminal = terminal;
+    token.value = value;
+    return tpc_parser_feed_tokens(self, &token, 1, &consumed, result_out);
+}
+
+/* Feeds an array of tokens to the parser */
+int
+tpc_parser_feed_tokens(tpc_parser_t self,
+                       const tpc_token_t *tokens,
+                       size_t count,
+                       size_t *consumed_out,
+                       void **result_out)
+{
+    const tpc_tables_t *tables;
+    const struct tpc_production *production;
+    const tpc_token_t *token = tokens;
+    const tpc_token_t *end = tokens + count;
+    tpc_frame_t *top;
+    tpc_frame_t *next;
+    int state;
+    int result = TPC_OK;
+    int nonterm_type;
+    int kind;
+    void *value;
+    size_t length;
+    int arg;
+
+    /* Finish the reset which failed after the last accept */
+    if (self->unready && tpc_parser_reset(self) < 0) {
+        *consumed_out = 0;
+        return TPC_ERR_NOMEM;
+    }
+
+    tables = self->tables;
+    top = self->top;
+    state = top->state;
+
+    /* Keep going until we run out of tokens */
+    while (token < end) {
+        unsigned long action;
+
+        /* The terminal comes from the caller's lexer */
+        if (token->terminal < 0 ||
+            ! (token->terminal < tables->terminal_count)) {
+            result = TPC_ERR_SYNTAX;
+            goto done;
+        }
+
+        action = read_entry(
+            tables->sr_table, tables->action_size,
+            (size_t)state * tables->terminal_count + token->terminal);
+
+        PROFILE_COUNT(self, visits, state);
+        switch (decode_action(tables, action, &arg)) {
+        case ACTION_REDUCE:
+            /* Make room for the result first, since the reduction
+             * can't be taken back once it has run */
+            PROFILE_COUNT(self, reductions, arg);
+            kind = tables->kinds == NULL ? TPC_REDUCE : tables->kinds[arg];
+            length = production_length(tables, arg);
+            if (length == 0 && ! (top + 1 < self->end)) {
+                if ((next = grow_stack(self, top)) == NULL) {
+                    result = TPC_ERR_NOMEM;
+                    goto done;
+                }
+
+                top = next;
+            }
+
+            /* Pop the production's components and reduce them, unless
+             * the tables want more than there are */
+            if (length > (size_t)(top - self->stack)) {
+                result = TPC_ERR_SYNTAX;
+                goto done;
+            }
+
+            top -= length;
+            if (tables->dispatch != NULL) {
+                nonterm_type = (int)read_entry(
+                    tables->nonterm_types, tables->symbol_size, arg);
+                if ((kind == TPC_REDUCE ?
+                     tables->dispatch(self->rock, arg, top + 1, &value) :
+                     reduce_builtin(kind, top + 1, &value)) < 0) {
+                    self->unready = 1;
+                    result = TPC_ERR_REDUCE;
+                    goto done;
+                }
+            } else {
+                production = tables->productions + arg;
+                nonterm_type = production->nonterm_type;
+                if ((kind == TPC_REDUCE ?
+                     production->reduction(self->rock, top + 1, &value) :
+                     reduce_builtin(kind, top + 1, &value)) < 0) {
+                    self->unready = 1;
+                    result = TPC_ERR_REDUCE;
+                    goto done;
+                }
+            }
+
+            /* Work out where the goto table says to go */
+            state = (int)read_entry(
+                tables->goto_table, tables->state_size,
+                (size_t)top->state * tables->nonterminal_count +
+                nonterm_type);
+            break;
+
+        case ACTION_SHIFT:
+            /* Shift in the token */
+            if ((next = push(self, top, arg, token->value)) == NULL) {
+                result = TPC_ERR_NOMEM;
+                goto done;
+            }
+
+            top = next;
+            state = arg;
+            token++;
+            continue;
+
+        case ACTION_ACCEPT:
+            /* Reduce by the entry point's start production and begin
+             * again */
+            PROFILE_COUNT(self, reductions, arg);
+            kind = tables->kinds == NULL ? TPC_REDUCE : tables->kinds[arg];
+            length = production_length(tables, arg);
+            if (length > (size_t)(top - self->stack)) {
+                result = TPC_ERR_SYNTAX;
+                goto done;
+            }
+
+            top -= length;
+            if (tables->dispatch != NULL) {
+                if ((kind == TPC_REDUCE ?
+                     tables->dispatch(self->rock, arg, top + 1, result_out) :
+                     reduce_builtin(kind, top + 1, result_out)) < 0) {
+                    self->unready = 1;
+                    result = TPC_ERR_REDUCE;
+                    goto done;
+                }
+            } else {
+                production = tables->productions + arg;
+                if ((kind == TPC_REDUCE ?
+                     production->reduction(self->rock, top + 1, result_out) :
+                     reduce_builtin(kind, top + 1, result_out)) < 0) {
+                    self->unready = 1;
+                    result = TPC_ERR_REDUCE;
+                    goto done;
+                }
+            }
+
+            /* The caller owns the result, so a failed reset waits to
+             * be reported by the next feed */
+            tpc_parser_reset(self);
+            result = TPC_ACCEPT;
+            top = self->top;
+            token++;
+            goto done;
+
+        default:
+            PROFILE_COUNT(self, errors, state);
+            result = TPC_ERR_SYNTAX;
+            goto done;
+        }
+
+        /* Push the result of the reduction into the room it left */
+        top = push(self, top, state, value);
+    }
+
+done:
+    self->top = top;
+    *consumed_out = token - tokens;
+    return result;
+}
+
+/* Returns the counts the receiver has gathered */
+const tpc_profile_t *
+tpc_parser_get_profile(tpc_parser_t self)
+{
+#ifdef TPC_PROFILE
+    return &self->profile;
+#else
+    return NULL;
+#endif
+}
+
+/* Writes the counts in the format `tpc --profile' reads */
+int
+tpc_profile_write(const tpc_profile_t *profile, FILE *file)
+{
+    int i;
+
+    fprintf(file, "# %d states, %d productions, at most %lu frames\n",
+            profile->kernel_count, profile->production_count,
+            (unsigned long)profile->max_depth);
+
+    /* Tpc skips comments, so the other counts go in those */
+    for (i = 0; i < profile->production_count; i++) {
+        if (profile->reductions[i] != 0) {
+            fprintf(file, "# reduce %d %lu\n", i, profile->reductions[i]);
+        }
+    }
+
+    for (i = 0; i < profile->kernel_count; i++) {
+        if (profile->errors[i] != 0) {
+            fprintf(file, "# error %d %lu\n", i, profile->errors[i]);
+        }
+    }
+
+    /* Then each state which was visited and how often */
+    for (i = 0; i < profile->kernel_count; i++) {
+        if (profile->visits[i] != 0) {
+            fprintf(file, "%d %lu\n", i, profile->visits[i]);
+        }
+    }
+
+    return ferror(file) ? -1 : 0;
+}
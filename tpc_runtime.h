@@ -0,0 +1,411 @@
+/***********************************************************************
+
+  Copyright (C) 1999-2006 by Mantara Software (ABN 17 105 665 594).
+  All Rights Reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   * Redistributions of source code must retain the above
+     copyright notice, this list of conditions and the following
+     disclaimer.
+
+   * Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials
+     provided with the distribution.
+
+   * Neither the name of the Mantara Software nor the names
+     of its contributors may be used to endorse or promote
+     products derived from this software without specific prior
+     written permission.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+   FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+   REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+   INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+   BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+   CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+   LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+   ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+   POSSIBILITY OF SUCH DAMAGE.
+
+***********************************************************************/
+
+
+#ifndef TPC_RUNTIME_H
+#define TPC_RUNTIME_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* The results of feeding a token to a parser */
+#define TPC_OK 0
+#define TPC_ACCEPT 1
+#define TPC_ERR_SYNTAX -1
+#define TPC_ERR_REDUCE -2
+#define TPC_ERR_NOMEM -3
+
+/* The encodings of shift/reduce table actions */
+#define TPC_ENCODING_RANGE 0
+#define TPC_ENCODING_TAGGED 1
+
+/* The kinds of production.  Tpc makes productions of the kinds other
+ * than TPC_REDUCE for components followed by `*', `+' or `?' and for
+ * the symbols named by %start, and libtpc builds their values itself
+ * instead of calling out. */
+#define TPC_REDUCE 0
+#define TPC_LIST_EMPTY 1
+#define TPC_LIST_ONE 2
+#define TPC_LIST_APPEND 3
+#define TPC_OPTION_NONE 4
+#define TPC_OPTION_SOME 5
+#define TPC_PASS 6
+
+/* A frame on the parser's stack: a state and the value which was
+ * shifted or reduced to get there */
+typedef struct tpc_frame
+{
+    /* The state */
+    int state;
+
+    /* The value */
+    void *value;
+} tpc_frame_t;
+
+/* The type of a reduction.  Args points to the frames of the
+ * production's components, in order.  A reduction stores its value
+ * in result_out and returns 0, or returns -1 if it fails. */
+typedef int (*tpc_reduction_t)(void *rock, tpc_frame_t *args,
+                               void **result_out);
+
+/* The value of a component followed by `*' or `+': the values of its
+ * repetitions in order.  A reduction which is handed a list owns it
+ * and should release it with tpc_list_free(). */
+typedef struct tpc_list
+{
+    /* The number of values in the list */
+    size_t count;
+
+    /* The number of values there is room for */
+    size_t capacity;
+
+    /* The values */
+    void **values;
+} tpc_list_t;
+
+/* The type of a function which calls the reduction of the numbered
+ * production, as written by `tpc --emit=switch' */
+typedef int (*tpc_dispatch_t)(void *rock, int production,
+                              tpc_frame_t *args, void **result_out);
+
+/* An entry in the productions table */
+struct tpc_production
+{
+    /* The function to call when reducing by the production */
+    tpc_reduction_t reduction;
+
+    /* The production's left-hand side */
+    int nonterm_type;
+
+    /* The number of components on its right-hand side */
+    int count;
+};
+
+/* A set of parse tables as written by `tpc --emit=runtime' */
+typedef struct tpc_tables
+{
+    /* The encoding of the shift/reduce table's actions */
+    int encoding;
+
+    /* The size of a shift/reduce table entry in bytes */
+    int action_size;
+
+    /* The size of a goto table entry in bytes */
+    int state_size;
+
+    /* The number of terminal symbols */
+    int terminal_count;
+
+    /* The number of nonterminal symbols */
+    int nonterminal_count;
+
+    /* The number of productions */
+    int production_count;
+
+    /* The number of kernels (states) */
+    int kernel_count;
+
+    /* The productions */
+    const struct tpc_production *productions;
+
+    /* The shift/reduce table, indexed by state and terminal */
+    const void *sr_table;
+
+    /* The goto table, indexed by state and nonterminal */
+    const void *goto_table;
+
+    /* The names of the terminal symbols */
+    const char *const *terminal_names;
+
+    /* The names of the nonterminal symbols */
+    const char *const *nonterminal_names;
+
+    /* The function which calls each production's reduction, or NULL
+     * if the reductions are found in the productions table */
+    tpc_dispatch_t dispatch;
+
+    /* The size of a nonterm_types or counts entry in bytes */
+    int symbol_size;
+
+    /* The left-hand side of each production, used with dispatch */
+    const void *nonterm_types;
+
+    /* The number of components of each production, used with dispatch */
+    const void *counts;
+
+    /* The size of an expected_index entry in bytes */
+    int expected_index_size;
+
+    /* The number of bytes in each expected set, or 0 if there are none */
+    int expected_size;
+
+    /* The expected set of each state, as an index into expected_sets */
+    const void *expected_index;
+
+    /* The distinct sets of terminals with an action in some state, as
+     * bitsets with terminal t at bit (t & 7) of byte (t >> 3) */
+    const unsigned char *expected_sets;
+
+    /* The kind of each production, or NULL if they're all TPC_REDUCE */
+    const unsigned char *kinds;
+
+    /* The number of entry points, or 0 if the only one is the first
+     * production's */
+    int start_count;
+
+    /* The state in which to begin parsing at each entry point */
+    const int *start_states;
+} tpc_tables_t;
+
+/* The type of a function which looks up a reduction by name */
+typedef tpc_reduction_t (*tpc_resolver_t)(void *rock, const char *name);
+
+/* The table slot type */
+typedef struct tpc_table_slot *tpc_table_slot_t;
+
+
+/* The magic number and version of the binary table format */
+#define TPC_BINARY_MAGIC 0x31435054
+#define TPC_BINARY_VERSION 1
+
+/* The alignment of each section of a binary table file */
+#define TPC_BINARY_ALIGN 8
+
+/* The header of a binary table file as written by `tpc --binary'.
+ * Every field is in the byte order of the machine which wrote it, and
+ * offsets are in bytes from the start of the file.  The productions
+ * section holds a (nonterm_type, count) pair of uint32_t for each
+ * production, and the names section holds the uint32_t offset into
+ * the strings section of the name of each terminal, each nonterminal
+ * and then each production's reduction.  The checksum is the Adler-32
+ * of everything after the header. */
+typedef struct tpc_binary_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t checksum;
+    uint32_t encoding;
+    uint32_t action_size;
+    uint32_t state_size;
+    uint32_t terminal_count;
+    uint32_t nonterminal_count;
+    uint32_t production_count;
+    uint32_t kernel_count;
+    uint32_t productions_offset;
+    uint32_t sr_table_offset;
+    uint32_t goto_table_offset;
+    uint32_t names_offset;
+    uint32_t strings_offset;
+} tpc_binary_header_t;
+
+/* Computes the Adler-32 checksum of a buffer */
+uint32_t tpc_adler32(const void *buffer, size_t length);
+
+/* A token to be fed to a parser */
+typedef struct tpc_token
+{
+    /* The token's terminal symbol */
+    int terminal;
+
+    /* The token's value */
+    void *value;
+} tpc_token_t;
+
+/* The parser type */
+typedef struct tpc_parser *tpc_parser_t;
+
+/* The counts a parser gathers when libtpc is built with TPC_PROFILE
+ * defined (configure --enable-profile).  Each parser keeps its own,
+ * so a parser which stays on one thread counts without atomics. */
+typedef struct tpc_profile
+{
+    /* The number of states counted */
+    int kernel_count;
+
+    /* The number of productions counted */
+    int production_count;
+
+    /* The number of times each state looked up a token's action */
+    unsigned long *visits;
+
+    /* The number of reductions by each production */
+    unsigned long *reductions;
+
+    /* The number of syntax errors found in each state */
+    unsigned long *errors;
+
+    /* The greatest number of frames the stack has held */
+    size_t max_depth;
+} tpc_profile_t;
+
+
+/* The reductions of the productions tpc makes for a component X
+ * followed by `*', `+' or `?'.  X* starts with an empty list and X+
+ * with a list of one value, and each further X is appended to the
+ * list in place.  X? is the value of X, or NULL if it's absent.
+ * Tables of every format name these as the reductions of those
+ * productions, and libtpc's driver performs them directly. */
+int tpc_list_empty(void *rock, tpc_frame_t *args, void **result_out);
+int tpc_list_one(void *rock, tpc_frame_t *args, void **result_out);
+int tpc_list_append(void *rock, tpc_frame_t *args, void **result_out);
+int tpc_option_none(void *rock, tpc_frame_t *args, void **result_out);
+int tpc_option_some(void *rock, tpc_frame_t *args, void **result_out);
+
+/* The reduction of the production tpc makes to accept a symbol named
+ * by %start, which answers the value of its one component */
+int tpc_pass(void *rock, tpc_frame_t *args, void **result_out);
+
+/* Releases a list, but not the values in it */
+void tpc_list_free(tpc_list_t *list);
+
+
+/* Maps a binary table file into memory, looking up each reduction
+ * with resolve.  Returns NULL if the file can't be read or is not a
+ * valid table file. */
+tpc_tables_t *tpc_tables_load(const char *filename,
+                              tpc_resolver_t resolve,
+                              void *rock);
+
+/* Releases a reference to tables returned by tpc_tables_load(),
+ * unmapping them once nothing refers to them */
+void tpc_tables_release(tpc_tables_t *tables);
+
+
+/* Allocates and initializes a new, empty tpc_table_slot_t */
+tpc_table_slot_t tpc_table_slot_alloc(void);
+
+/* Releases the resources consumed by the receiver */
+void tpc_table_slot_free(tpc_table_slot_t self);
+
+/* Loads a binary table file and atomically makes it the receiver's
+ * current tables.  Parsers which are part way through a parse keep
+ * using the old tables until they next reset.  Returns 0 on
+ * success or -1 if the file could not be loaded. */
+int tpc_table_slot_load(tpc_table_slot_t self,
+                        const char *filename,
+                        tpc_resolver_t resolve,
+                        void *rock);
+
+/* Returns a new reference to the receiver's current tables (or NULL
+ * if it has none), which should be released with
+ * tpc_tables_release() */
+tpc_tables_t *tpc_table_slot_acquire(tpc_table_slot_t self);
+
+
+/* Allocates and initializes a new tpc_parser_t with room for
+ * capacity frames on its stack */
+tpc_parser_t tpc_parser_alloc(const tpc_tables_t *tables,
+                              size_t capacity,
+                              void *rock);
+
+/* Allocates and initializes a new tpc_parser_t which takes the
+ * current tables of the slot each time it begins a parse */
+tpc_parser_t tpc_parser_alloc_with_slot(tpc_table_slot_t slot,
+                                        size_t capacity,
+                                        void *rock);
+
+/* Releases the resources consumed by the receiver */
+void tpc_parser_free(tpc_parser_t self);
+
+/* Discards any partial parse so that parsing can start afresh.
+ * Returns -1 if the parser's slot has no tables, there is no memory
+ * to count the new tables' states or the tables lack the parser's
+ * entry point, otherwise 0. */
+int tpc_parser_reset(tpc_parser_t self);
+
+/* Discards any partial parse and begins parsing at the numbered
+ * entry point from now on: 0 for the first production, or the
+ * position of a symbol among the %start declarations counting from
+ * 1.  Returns -1 if the tables have no such entry point or
+ * tpc_parser_reset() fails, otherwise 0. */
+int tpc_parser_start(tpc_parser_t self, int entry);
+
+/* Returns the receiver's current state */
+int tpc_parser_get_state(tpc_parser_t self);
+
+/* Performs all possible reductions and then shifts in the terminal.
+ * Returns TPC_OK after a shift, TPC_ACCEPT with the value of the
+ * start production in result_out after accepting, or one of the
+ * TPC_ERR codes, TPC_ERR_SYNTAX among them if the terminal is not
+ * one of the tables'.  The caller always owns an accepted value: if
+ * the parser can't reset itself afterwards then the next call tries
+ * again and returns TPC_ERR_NOMEM without consuming anything if it
+ * still can't.  After TPC_ERR_REDUCE the partial parse is discarded,
+ * along with the values on the stack, and the next call begins
+ * afresh.  After TPC_ERR_NOMEM the terminal has not been consumed
+ * and the partial parse is intact, so it may be fed again. */
+int tpc_parser_feed(tpc_parser_t self, int terminal, void *value,
+                    void **result_out);
+
+/* Feeds an array of tokens to the parser, stopping early after
+ * accepting or on error.  Stores the number of tokens consumed in
+ * consumed_out and returns as tpc_parser_feed() does for the last of
+ * them, or TPC_OK if count is zero. */
+int tpc_parser_feed_tokens(tpc_parser_t self,
+                           const tpc_token_t *tokens,
+                           size_t count,
+                           size_t *consumed_out,
+                           void **result_out);
+
+/* Answers nonzero if the terminal has an action in the receiver's
+ * current state.  With LALR tables a terminal which does may still
+ * turn out to be an error once the parser has reduced on it. */
+int tpc_parser_expects(tpc_parser_t self, int terminal);
+
+/* Stores up to count of the terminals with an action in the
+ * receiver's current state in terminals, in ascending order, and
+ * returns how many there are in all */
+size_t tpc_parser_get_expected(tpc_parser_t self,
+                               int *terminals,
+                               size_t count);
+
+/* Returns the counts the receiver has gathered since it was
+ * allocated, or NULL if libtpc was built without TPC_PROFILE.  The
+ * counts start again whenever a reset picks up tables of a different
+ * size from the parser's slot. */
+const tpc_profile_t *tpc_parser_get_profile(tpc_parser_t self);
+
+/* Writes the counts as `state visits' lines which `tpc --profile'
+ * reads, with the reductions, errors and stack depth in comments.
+ * Files from several parsers may simply be concatenated.  Returns 0
+ * on success or -1 if the file could not be written. */
+int tpc_profile_write(const tpc_profile_t *profile, FILE *file);
+
+#endif /* TPC_RUNTIME_H */